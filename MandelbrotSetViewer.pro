@@ -22,6 +22,9 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# 双双/四双精度的无误差变换要求严格的double舍入, 32位mingw默认的x87扩展精度会破坏之
+*-g++*: QMAKE_CXXFLAGS += -msse2 -mfpmath=sse
+
 LIBS += D:\\aouair\\QProjects\\MandelbrotSetViewer\\lua\\liblua.a
 
 SOURCES += \
@@ -29,13 +32,35 @@ SOURCES += \
         mainwindow.cpp \
     mandelbrot.cpp \
     calculatormanager.cpp \
-    timesrender.cpp
+    timesrender.cpp \
+    simdkernel.cpp \
+    tilescheduler.cpp \
+    bigfixed.cpp \
+    perturbation.cpp \
+    bla.cpp \
+    floatexp.cpp \
+    imageitem.cpp \
+    tilecache.cpp \
+    tilestore.cpp \
+    viewhistory.cpp
 
 HEADERS += \
         mainwindow.h \
     mandelbrot.h \
     calculatormanager.h \
-    timesrender.h
+    timesrender.h \
+    simdkernel.h \
+    tilescheduler.h \
+    bigfixed.h \
+    perturbation.h \
+    bla.h \
+    doubledouble.h \
+    quaddouble.h \
+    floatexp.h \
+    imageitem.h \
+    tilecache.h \
+    tilestore.h \
+    viewhistory.h
 
 FORMS += \
         mainwindow.ui
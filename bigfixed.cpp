@@ -0,0 +1,268 @@
+#include "bigfixed.h"
+#include <QByteArray>
+#include <cmath>
+#include <cstring>
+
+namespace Mandelbrot {
+
+    BigFixed::BigFixed(int frac_limbs) :
+        frac(qBound(1, frac_limbs, (int)MAX_FRAC_LIMBS)), negative(false) {
+        memset(limbs, 0, sizeof(limbs));
+    }
+
+    BigFixed::BigFixed(double value, int frac_limbs) :
+        frac(qBound(1, frac_limbs, (int)MAX_FRAC_LIMBS)), negative(value < 0) {
+        memset(limbs, 0, sizeof(limbs));
+        double v = std::fabs(value);
+        // 逐段取出整数部分, double只有53位, 取到其后的段均为0
+        for(int k = frac; k >= 0 && v > 0; k--) {
+            double d = std::floor(v);
+            limbs[k] = (quint32)d;
+            v = std::ldexp(v - d, 32);
+        }
+    }
+
+    BigFixed::BigFixed(FloatExp const& value, int frac_limbs) :
+        frac(qBound(1, frac_limbs, (int)MAX_FRAC_LIMBS)), negative(value.m < 0) {
+        memset(limbs, 0, sizeof(limbs));
+        if(value.isZero() || !value.isFinite()) {
+            return;
+        }
+        // 最高位2^e所在的段, 低于末段时整个值被截去
+        const int bit = value.e + 32 * frac;
+        if(bit < 0) {
+            return;
+        }
+        int top = qMin(bit / 32, frac);
+        // 该段以上的部分化为double后与double版相同逐段取出
+        double v = std::ldexp(std::fabs(value.m), value.e - 32 * (top - frac));
+        for(int k = top; k >= 0 && v > 0; k--) {
+            double d = std::floor(v);
+            limbs[k] = (quint32)d;
+            v = std::ldexp(v - d, 32);
+        }
+    }
+
+    QString BigFixed::toHexString(int frac_bits) const {
+        frac_bits = qBound(0, frac_bits, 32 * frac);
+        const int n = (frac_bits + 31) / 32;
+        // 写出的末段只保留其高frac_bits - 32(n - 1)位
+        const int rest = 32 * n - frac_bits;
+        quint32 digits[MAX_FRAC_LIMBS + 1];
+        bool zero = true;
+        for(int i = 0; i <= n; i++) {
+            digits[i] = limbs[frac - i];
+            if(i == n && n > 0 && rest > 0) {
+                digits[i] &= ~((1u << rest) - 1);
+            }
+            zero = zero && digits[i] == 0;
+        }
+        QString s = negative && !zero ? "-" : "";
+        s += QString::number(digits[0], 16) + ".";
+        for(int i = 1; i <= n; i++) {
+            s += QString("%1").arg(digits[i], 8, 16, QChar('0'));
+        }
+        return s;
+    }
+
+    int BigFixed::limbsForSpacing(FloatExp const& pixel_spacing) {
+        int bits = 64;
+        // 间距为m 2^e, 1 <= m < 2, 需要-e位小数
+        if(pixel_spacing.m > 0 && pixel_spacing.e < 0) {
+            bits += -pixel_spacing.e;
+        }
+        return qBound(2, (bits + 31) / 32, (int)MAX_FRAC_LIMBS);
+    }
+
+    bool BigFixed::mulSmall(quint32 m) {
+        quint64 carry = 0;
+        for(int k = 0; k <= frac; k++) {
+            quint64 cur = (quint64)limbs[k] * m + carry;
+            limbs[k] = (quint32)cur;
+            carry = cur >> 32;
+        }
+        return carry == 0;
+    }
+
+    void BigFixed::divSmall(quint32 d) {
+        quint64 rem = 0;
+        for(int k = frac; k >= 0; k--) {
+            quint64 cur = (rem << 32) | limbs[k];
+            limbs[k] = (quint32)(cur / d);
+            rem = cur % d;
+        }
+    }
+
+    bool BigFixed::fromString(QString const& str, int frac_limbs, BigFixed& out) {
+        out = BigFixed(frac_limbs);
+        QByteArray s = str.trimmed().toLatin1();
+        const char* p = s.constData();
+        bool neg = false;
+        if(*p == '+' || *p == '-') {
+            neg = *p == '-';
+            p++;
+        }
+        // 整数部分按霍纳法累乘
+        bool any = false;
+        for(; *p >= '0' && *p <= '9'; p++) {
+            any = true;
+            if(!out.mulSmall(10)) return false;
+            quint64 cur = (quint64)out.limbs[out.frac] + (*p - '0');
+            if(cur >> 32) return false;
+            out.limbs[out.frac] = (quint32)cur;
+        }
+        // 小数部分从最低位起逐位累加再除以10
+        if(*p == '.') {
+            p++;
+            const char* begin = p;
+            while(*p >= '0' && *p <= '9') p++;
+            if(p > begin) any = true;
+            BigFixed f(frac_limbs);
+            for(const char* q = p - 1; q >= begin; q--) {
+                f.limbs[f.frac] = *q - '0';
+                f.divSmall(10);
+            }
+            addAbs(out, f, out);
+        }
+        if(!any) return false;
+        if(*p == 'e' || *p == 'E') {
+            p++;
+            bool eneg = false;
+            if(*p == '+' || *p == '-') {
+                eneg = *p == '-';
+                p++;
+            }
+            if(!(*p >= '0' && *p <= '9')) return false;
+            int e = 0;
+            for(; *p >= '0' && *p <= '9'; p++) {
+                e = e * 10 + (*p - '0');
+                if(e > 100000) return false;
+            }
+            for(int i = 0; i < e; i++) {
+                if(eneg) {
+                    out.divSmall(10);
+                } else if(!out.mulSmall(10)) {
+                    return false;
+                }
+            }
+        }
+        if(*p != '\0') return false;
+        out.negative = neg;
+        return true;
+    }
+
+    double BigFixed::toDouble() const {
+        double v = 0;
+        int used = 0;
+        for(int k = frac; k >= 0 && used < 3; k--) {
+            if(limbs[k] || used) {
+                v += std::ldexp((double)limbs[k], 32 * (k - frac));
+                used++;
+            }
+        }
+        return negative ? -v : v;
+    }
+
+    FloatExp BigFixed::toFloatExp() const {
+        FloatExp v;
+        int used = 0;
+        for(int k = frac; k >= 0 && used < 3; k--) {
+            if(limbs[k] || used) {
+                v = v + FloatExp((double)limbs[k], 32 * (k - frac));
+                used++;
+            }
+        }
+        return negative ? -v : v;
+    }
+
+    void BigFixed::toDoubles(double* out, int n) const {
+        BigFixed r = *this;
+        for(int i = 0; i < n; i++) {
+            out[i] = r.toDouble();
+            BigFixed::sub(r, BigFixed(out[i], frac), r);
+        }
+    }
+
+    int BigFixed::cmpAbs(BigFixed const& a, BigFixed const& b) {
+        for(int k = a.frac; k >= 0; k--) {
+            if(a.limbs[k] != b.limbs[k]) {
+                return a.limbs[k] < b.limbs[k] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    void BigFixed::addAbs(BigFixed const& a, BigFixed const& b, BigFixed& out) {
+        quint64 carry = 0;
+        for(int k = 0; k <= a.frac; k++) {
+            quint64 cur = (quint64)a.limbs[k] + b.limbs[k] + carry;
+            out.limbs[k] = (quint32)cur;
+            carry = cur >> 32;
+        }
+        out.frac = a.frac;
+    }
+
+    // 假定|a| >= |b|
+    void BigFixed::subAbs(BigFixed const& a, BigFixed const& b, BigFixed& out) {
+        qint64 borrow = 0;
+        for(int k = 0; k <= a.frac; k++) {
+            qint64 cur = (qint64)a.limbs[k] - b.limbs[k] - borrow;
+            borrow = cur < 0;
+            out.limbs[k] = (quint32)(cur + (borrow << 32));
+        }
+        out.frac = a.frac;
+    }
+
+    void BigFixed::add(BigFixed const& a, BigFixed const& b, BigFixed& out) {
+        if(a.negative == b.negative) {
+            bool neg = a.negative;
+            addAbs(a, b, out);
+            out.negative = neg;
+        } else if(cmpAbs(a, b) >= 0) {
+            bool neg = a.negative;
+            subAbs(a, b, out);
+            out.negative = neg;
+        } else {
+            bool neg = b.negative;
+            subAbs(b, a, out);
+            out.negative = neg;
+        }
+    }
+
+    void BigFixed::sub(BigFixed const& a, BigFixed const& b, BigFixed& out) {
+        BigFixed nb = b;
+        nb.negative = !b.negative;
+        add(a, nb, out);
+    }
+
+    /**
+     * 截断的竖式乘法: 只计算对结果有影响的积段, 另留一段保护位, 误差不超过末段数个单位
+     */
+    void BigFixed::mul(BigFixed const& a, BigFixed const& b, BigFixed& out) {
+        const int n = a.frac + 1;
+        quint32 t[2 * (MAX_FRAC_LIMBS + 1)];
+        memset(t, 0, sizeof(quint32) * 2 * n);
+        const int low = a.frac - 1;
+        for(int i = 0; i < n; i++) {
+            if(a.limbs[i] == 0) continue;
+            quint64 carry = 0;
+            int j = qMax(0, low - i);
+            for(; j < n; j++) {
+                quint64 cur = (quint64)a.limbs[i] * b.limbs[j] + t[i + j] + carry;
+                t[i + j] = (quint32)cur;
+                carry = cur >> 32;
+            }
+            for(int k = i + n; carry && k < 2 * n; k++) {
+                quint64 cur = (quint64)t[k] + carry;
+                t[k] = (quint32)cur;
+                carry = cur >> 32;
+            }
+        }
+        bool neg = a.negative != b.negative;
+        for(int k = 0; k < n; k++) {
+            out.limbs[k] = t[k + a.frac];
+        }
+        out.frac = a.frac;
+        out.negative = neg;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef BIGFIXED_H
+#define BIGFIXED_H
+
+#include <QString>
+#include <QtGlobal>
+#include "floatexp.h"
+
+namespace Mandelbrot {
+
+    /**
+     * @brief 高精度定点数, 用于深度缩放的参考轨道
+     * 符号与绝对值分开存放, 绝对值按32位分段小端存放:
+     * limbs[0..frac-1]为小数部分, limbs[frac]为整数部分
+     * 参与运算的数须有相同的小数段数
+     */
+    class BigFixed {
+    public:
+        enum { MAX_FRAC_LIMBS = 128 };
+
+    private:
+        quint32 limbs[MAX_FRAC_LIMBS + 1];
+        int frac;
+        bool negative;
+
+        static int cmpAbs(BigFixed const& a, BigFixed const& b);
+        static void addAbs(BigFixed const& a, BigFixed const& b, BigFixed& out);
+        static void subAbs(BigFixed const& a, BigFixed const& b, BigFixed& out);
+        bool mulSmall(quint32 m);
+        void divSmall(quint32 d);
+
+    public:
+        explicit BigFixed(int frac_limbs = 2);
+        BigFixed(double value, int frac_limbs);
+        // 低于末段的位截去, 整数部分须在32位以内
+        BigFixed(FloatExp const& value, int frac_limbs);
+
+        // 解析十进制串, 如"-0.74364388703715870475e-3"
+        static bool fromString(QString const& str, int frac_limbs, BigFixed& out);
+        // 像素间距所需的小数段数, 另留64位保护位
+        static int limbsForSpacing(FloatExp const& pixel_spacing);
+
+        int fracLimbs() const { return frac; }
+        double toDouble() const;
+        // 不受double指数范围限制, 用于深度缩放时换算坐标差
+        FloatExp toFloatExp() const;
+        // 展开为n个double之和, 从高到低依次存入out, 用于转换为双双/四双精度
+        void toDoubles(double* out, int n) const;
+        void negate() { negative = !negative; }
+        // 截到frac_bits位小数后逐段写出的十六进制文本, 用作缓存键
+        QString toHexString(int frac_bits) const;
+
+        static void add(BigFixed const& a, BigFixed const& b, BigFixed& out);
+        static void sub(BigFixed const& a, BigFixed const& b, BigFixed& out);
+        static void mul(BigFixed const& a, BigFixed const& b, BigFixed& out);
+    };
+}
+
+#endif // BIGFIXED_H
@@ -0,0 +1,101 @@
+#include "bla.h"
+#include "perturbation.h"
+#include "floatexp.h"
+#include <cmath>
+
+namespace Mandelbrot {
+
+    template<typename R>
+    const double BlaTable<R>::EPSILON = 1.0 / (1 << 24);
+
+    template<typename R>
+    void BlaTable<R>::build(ReferenceOrbit const& orbit, R dc_max) {
+        using std::sqrt;
+        const R zero(0);
+        levels.clear();
+        const int last = orbit.size() - 1;
+        if(last < 2) {
+            return;
+        }
+        const double* ref_r = orbit.real();
+        const double* ref_i = orbit.imag();
+
+        // 单步: 由Z_m到Z_(m+1), m = 1..last-1
+        QVector<Step> level(last - 1);
+        for(int m = 1; m < last; m++) {
+            Step& s = level[m - 1];
+            s.a_real = 2 * ref_r[m];
+            s.a_imag = 2 * ref_i[m];
+            s.b_real = 1;
+            s.b_imag = 0;
+            R a = sqrt(s.a_real * s.a_real + s.a_imag * s.a_imag);
+            R r = qMax(zero, (EPSILON * a - dc_max) / (a + 1));
+            s.r2 = r * r;
+        }
+        levels.append(level);
+
+        // 逐层两两合并, 先走x段再走y段
+        while(levels.last().size() > 1) {
+            QVector<Step> const& lower = levels.last();
+            QVector<Step> upper(lower.size() / 2);
+            for(int j = 0; j < upper.size(); j++) {
+                Step const& x = lower[2 * j];
+                Step const& y = lower[2 * j + 1];
+                Step& s = upper[j];
+                s.a_real = y.a_real * x.a_real - y.a_imag * x.a_imag;
+                s.a_imag = y.a_real * x.a_imag + y.a_imag * x.a_real;
+                s.b_real = y.a_real * x.b_real - y.a_imag * x.b_imag + y.b_real;
+                s.b_imag = y.a_real * x.b_imag + y.a_imag * x.b_real + y.b_imag;
+                R ax = sqrt(x.a_real * x.a_real + x.a_imag * x.a_imag);
+                R bx = sqrt(x.b_real * x.b_real + x.b_imag * x.b_imag);
+                R ry = ax > zero ? qMax(zero, (sqrt(y.r2) - bx * dc_max) / ax) : zero;
+                R r = qMin(sqrt(x.r2), ry);
+                s.r2 = r * r;
+            }
+            levels.append(upper);
+        }
+
+        // 浅层缩放时dc过大, 各段半径全为0, 查表只会白白增加开销
+        bool any = false;
+        for(int k = 1; k < levels.size() && !any; k++) {
+            for(int j = 0; j < levels[k].size(); j++) {
+                if(levels[k][j].r2 > zero) {
+                    any = true;
+                    break;
+                }
+            }
+        }
+        if(!any) {
+            levels.clear();
+        }
+    }
+
+    template<typename R>
+    const typename BlaTable<R>::Step* BlaTable<R>::lookup(int m, R const& dz_norm, size_t max_length,
+                                                          int& length) const {
+        if(m < 1) {
+            return NULL;
+        }
+        const int j = m - 1;
+        // 起点须对齐到2^k; 单步线性化并不比直接迭代省时, 只查两步以上的段
+        int k = 0;
+        while(k + 1 < levels.size() && (j & (1 << k)) == 0) {
+            k++;
+        }
+        for(; k >= 1; k--) {
+            int index = j >> k;
+            if(index >= levels[k].size() || (size_t)1 << k > max_length) {
+                continue;
+            }
+            Step const& s = levels[k][index];
+            if(dz_norm < s.r2) {
+                length = 1 << k;
+                return &s;
+            }
+        }
+        return NULL;
+    }
+
+    template class BlaTable<double>;
+    template class BlaTable<FloatExp>;
+}
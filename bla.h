@@ -0,0 +1,48 @@
+#ifndef BLA_H
+#define BLA_H
+
+#include <QVector>
+
+namespace Mandelbrot {
+
+    class ReferenceOrbit;
+
+    /**
+     * @brief 双变量线性近似(BLA)表
+     * 偏移较小时一步迭代可线性化为 dz' = A dz + B dc, 其中 A = 2Z_m, B = 1;
+     * 相邻两段可合并为一段: A = A2 A1, B = A2 B1 + B2. 表按层存放, 第k层每项合并2^k步,
+     * 起点为m = 1 + j 2^k, 只要|dz|小于该项的有效半径即可一次跳过整段
+     * R为系数与半径的类型, 超出double指数范围的深度缩放时用FloatExp
+     */
+    template<typename R>
+    class BlaTable {
+    public:
+        struct Step {
+            R a_real;
+            R a_imag;
+            R b_real;
+            R b_imag;
+            R r2; // 有效半径的平方
+        };
+
+        // 线性化的相对误差容限
+        static const double EPSILON;
+
+    private:
+        QVector<QVector<Step> > levels;
+
+    public:
+        // dc_max为图像内dc的最大模长
+        void build(ReferenceOrbit const& orbit, R dc_max);
+        void clear() { levels.clear(); }
+        bool isEmpty() const { return levels.isEmpty(); }
+
+        /**
+         * @brief 在参考轨道第m次处查找|dz|^2 < r2且步数不超过max_length的最长一段
+         * 找不到时返回NULL
+         */
+        const Step* lookup(int m, R const& dz_norm, size_t max_length, int& length) const;
+    };
+}
+
+#endif // BLA_H
@@ -1,25 +1,195 @@
 #include "calculatormanager.h"
 #include <QTime>
+#include <algorithm>
+#include <cstring>
 
-CalculatorManager::CalculatorManager(Mandelbrot::Reader<double>& reader, int thread_total) :
-    r(reader), thread_total(thread_total) {
+namespace {
+    /**
+     * @brief 按预估代价从高到低排序块序号
+     */
+    struct CostGreater {
+        QVector<size_t> const& cost;
+        explicit CostGreater(QVector<size_t> const& cost) : cost(cost) {}
+        bool operator()(int a, int b) const {
+            return cost[a] > cost[b];
+        }
+    };
+
+    /**
+     * @brief 在线程池中试算第worker, worker + step, ...块的代价, 各线程写入cost的不同元素
+     */
+    class CostProbe : public QRunnable {
+    private:
+        Mandelbrot::CalcTask& task;
+        size_t* const cost;
+        const int tile_total;
+        const int worker;
+        const int step;
+        const size_t probe_times;
+        Mandelbrot::CancelToken const& token;
+        Mandelbrot::CalcOptions const& opt;
+
+    public:
+        CostProbe(Mandelbrot::CalcTask& task, size_t* cost, int tile_total, int worker, int step,
+                  size_t probe_times, Mandelbrot::CancelToken const& token, Mandelbrot::CalcOptions const& opt) :
+            task(task), cost(cost), tile_total(tile_total), worker(worker), step(step), probe_times(probe_times),
+            token(token), opt(opt) {
+            setAutoDelete(true);
+        }
+
+        virtual void run() {
+            for(int i = worker; i < tile_total && !token.isCancelled(); i += step) {
+                cost[i] = task.estimateCost(i, probe_times, opt);
+            }
+        }
+    };
+}
+
+CalculatorManager::CalculatorManager(Mandelbrot::CalcTask* task, QThreadPool& pool, int thread_total,
+                                     Mandelbrot::CalcOptions const& opt) :
+    task(task), pool(pool), thread_total(thread_total), token(), opt(opt), stats(),
+    tile_report(false), tiles_mutex(), finished_tiles(), snapshot_src(NULL), snapshot(NULL) {
+}
+
+CalculatorManager::~CalculatorManager() {
+    delete task;
+    delete snapshot;
+}
+
+void CalculatorManager::cancel() {
+    token.cancel();
+}
+
+bool CalculatorManager::isCancelled() const {
+    return token.isCancelled();
+}
+
+Mandelbrot::CalcStats const& CalculatorManager::getStats() const {
+    return stats;
+}
+
+void CalculatorManager::enableTileReport() {
+    tile_report = true;
+}
+
+void CalculatorManager::takeFinishedTiles(QVector<Mandelbrot::Tile>& tiles) {
+    QMutexLocker locker(&tiles_mutex);
+    tiles += finished_tiles;
+    finished_tiles.clear();
+}
+
+void CalculatorManager::enableStageSnapshot(Mandelbrot::TimesBuffer const* buf) {
+    snapshot_src = buf;
+}
+
+Mandelbrot::TimesBuffer* CalculatorManager::takeStageSnapshot() {
+    QMutexLocker locker(&tiles_mutex);
+    Mandelbrot::TimesBuffer* s = snapshot;
+    snapshot = NULL;
+    return s;
+}
+
+/**
+ * @brief 从调度器取走完成的块换算为矩形, 有新块时通知界面
+ */
+void CalculatorManager::collectTiles(Mandelbrot::TileScheduler& sched) {
+    QVector<int> done;
+    sched.takeFinished(done);
+    if(done.isEmpty()) {
+        return;
+    }
+    {
+        QMutexLocker locker(&tiles_mutex);
+        for(int i = 0; i < done.size(); i++) {
+            Mandelbrot::Tile tile;
+            task->getTile(done[i], tile);
+            finished_tiles.append(tile);
+        }
+    }
+    emit tilesFinished();
 }
 
 void CalculatorManager::run() {
     emit progress(0);
     QTime t;
     t.start();
-    QThreadPool pool;
+
+    // 核心的预计算(如参考轨道)
+    task->prepare(token);
+    if(token.isCancelled()) {
+        return;
+    }
+
+    // 线程池由调用方持有, 空闲线程在多次任务间复用
+    if(pool.maxThreadCount() < thread_total) {
+        pool.setMaxThreadCount(thread_total);
+    }
+
+    // 试算各块代价, 昂贵的块优先分配; 试算同样分给各计算线程, 不在本线程逐块进行
+    int tile_total = task->getTileCount();
+    size_t probe_times = qMin(task->getMaxTimes(), (size_t)PROBE_MAX_TIMES);
+    QVector<size_t> cost(tile_total);
+    QVector<int> order(tile_total);
+    // 先取得独占的数据指针, 各线程写入时不会触发QVector的复制
+    size_t* cost_data = cost.data();
     for(int i = 0; i < thread_total; i++) {
-        Mandelbrot::Calculator<double>* c = new Mandelbrot::Calculator<double>(r);
-        pool.start(c);
+        pool.start(new CostProbe(*task, cost_data, tile_total, i, thread_total, probe_times, token, opt));
+    }
+    pool.waitForDone();
+    if(token.isCancelled()) {
+        return;
     }
+    for(int i = 0; i < tile_total; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), CostGreater(cost));
+
+    stats = Mandelbrot::CalcStats();
+    const int stage_total = task->getStageCount();
     int p = 0;
-    while(!pool.waitForDone(1)) {
-        int new_p = r.getProgress();
-        if(new_p != p) {
-            p = new_p;
-            emit progress(p);
+    for(int stage = 0; stage < stage_total; stage++) {
+        task->setStage(stage);
+        Mandelbrot::TileScheduler sched(order, thread_total);
+        QVector<Mandelbrot::CalcStats> worker_stats(thread_total);
+        for(int i = 0; i < thread_total; i++) {
+            pool.start(task->createCalculator(sched, i, token, opt, worker_stats[i]));
+        }
+        QTime report;
+        report.start();
+        while(!pool.waitForDone(1)) {
+            int new_p = (stage * 100 + sched.getProgress()) / stage_total;
+            if(new_p != p) {
+                p = new_p;
+                emit progress(p);
+            }
+            if(tile_report && report.elapsed() >= TILE_REPORT_MS) {
+                collectTiles(sched);
+                report.restart();
+            }
+        }
+        if(token.isCancelled()) {
+            return;
+        }
+        if(tile_report) {
+            collectTiles(sched);
+        }
+        for(int i = 0; i < thread_total; i++) {
+            stats.add(worker_stats[i]);
+        }
+        // 读取器的收尾(如写入磁盘块缓存)在本线程进行, 不占用计算线程
+        task->finishStage();
+        if(stage + 1 < stage_total) {
+            if(snapshot_src) {
+                // 各线程已结束, 缓冲此时不被改写; QVector的复制是共享的, 须逐字节复制
+                const int w = snapshot_src->width();
+                const int h = snapshot_src->height();
+                Mandelbrot::TimesBuffer* s = new Mandelbrot::TimesBuffer(w, h, snapshot_src->getMaxTimes());
+                memcpy(s->bits(), snapshot_src->constScanLine(0), (size_t)w * h * sizeof(quint32));
+                QMutexLocker locker(&tiles_mutex);
+                delete snapshot;
+                snapshot = s;
+            }
+            emit stageFinished(stage, stage_total);
         }
     }
     emit progress(100);
@@ -7,15 +7,55 @@
 class CalculatorManager : public QThread {
     Q_OBJECT
 private:
-    Mandelbrot::Reader<double>& r;
+    Mandelbrot::CalcTask* const task;
+    QThreadPool& pool;
     const int thread_total;
+    Mandelbrot::CancelToken token;
+    const Mandelbrot::CalcOptions opt;
+    Mandelbrot::CalcStats stats;
+    bool tile_report;
+    QMutex tiles_mutex;
+    QVector<Mandelbrot::Tile> finished_tiles;
+    Mandelbrot::TimesBuffer const* snapshot_src;
+    Mandelbrot::TimesBuffer* snapshot; // 最近一遍结束时snapshot_src的副本
+
+    // 代价试算时的迭代上限
+    enum { PROBE_MAX_TIMES = 1024 };
+    // 逐块显示时汇报已完成块的间隔
+    enum { TILE_REPORT_MS = 200 };
+
+    void collectTiles(Mandelbrot::TileScheduler& sched);
 
 public:
-    CalculatorManager(Mandelbrot::Reader<double>& reader, int thread_total);
+    // 接管task的所有权
+    CalculatorManager(Mandelbrot::CalcTask* task, QThreadPool& pool, int thread_total,
+                      Mandelbrot::CalcOptions const& opt);
+    ~CalculatorManager();
     virtual void run();
 
+    // 请求终止, 计算线程在当前行结束后退出, 被终止的任务不发出finished
+    void cancel();
+    bool isCancelled() const;
+
+    // 计算统计, 仅在finished之后读取
+    Mandelbrot::CalcStats const& getStats() const;
+
+    // 在start之前调用, 此后计算中定时发出tilesFinished
+    void enableTileReport();
+    // 取走已完成的块, 这些块此后不再被写入
+    void takeFinishedTiles(QVector<Mandelbrot::Tile>& tiles);
+    // 在start之前调用, 此后除末遍外每遍结束时先在本线程复制buf再发出stageFinished,
+    // 下一遍随即改写buf, 界面只应读取副本
+    void enableStageSnapshot(Mandelbrot::TimesBuffer const* buf);
+    // 取走最近一遍的副本, 由调用者释放; 没有时返回NULL
+    Mandelbrot::TimesBuffer* takeStageSnapshot();
+
 signals:
     void progress(int percentage);
+    // 分遍计算时除末遍外每遍结束发出, 此时下一遍已在改写缓冲, 完整的粗略图由takeStageSnapshot取得
+    void stageFinished(int stage, int stage_total);
+    // 有新完成的块可取
+    void tilesFinished();
     void finished(int ms_time);
 };
 
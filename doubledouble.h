@@ -0,0 +1,122 @@
+#ifndef DOUBLEDOUBLE_H
+#define DOUBLEDOUBLE_H
+
+namespace Mandelbrot {
+
+    /**
+     * @brief 无误差变换: 返回值s与误差e满足 s + e 精确等于运算结果
+     * 均为无分支的double运算, 便于编译器向量化; 要求严格的double舍入,
+     * x86下须用SSE2而非x87扩展精度, 且不可将split中的乘加融合为FMA
+     */
+    namespace Eft {
+        // 要求|a| >= |b|
+        inline double quickTwoSum(double a, double b, double& e) {
+            double s = a + b;
+            e = b - (s - a);
+            return s;
+        }
+
+        inline double twoSum(double a, double b, double& e) {
+            double s = a + b;
+            double bb = s - a;
+            e = (a - (s - bb)) + (b - bb);
+            return s;
+        }
+
+        // Dekker拆分, hi与lo各不超过26位有效数字
+        inline void split(double a, double& hi, double& lo) {
+            double t = 134217729.0 * a;
+            hi = t - (t - a);
+            lo = a - hi;
+        }
+
+        inline double twoProd(double a, double b, double& e) {
+            double p = a * b;
+            double a_hi, a_lo, b_hi, b_lo;
+            split(a, a_hi, a_lo);
+            split(b, b_hi, b_lo);
+            e = ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+            return p;
+        }
+    }
+
+    /**
+     * @brief 双双精度数, 值为hi + lo, 约106位有效数字
+     */
+    class DoubleDouble {
+    public:
+        double hi;
+        double lo;
+
+        DoubleDouble() : hi(0), lo(0) {}
+        DoubleDouble(double x) : hi(x), lo(0) {}
+        DoubleDouble(double hi, double lo) {
+            this->hi = Eft::quickTwoSum(hi, lo, this->lo);
+        }
+        double toDouble() const { return hi + lo; }
+
+        DoubleDouble operator-() const {
+            DoubleDouble r;
+            r.hi = -hi;
+            r.lo = -lo;
+            return r;
+        }
+    };
+
+    inline DoubleDouble operator+(DoubleDouble const& a, DoubleDouble const& b) {
+        double s2, t2;
+        double s1 = Eft::twoSum(a.hi, b.hi, s2);
+        double t1 = Eft::twoSum(a.lo, b.lo, t2);
+        s2 += t1;
+        s1 = Eft::quickTwoSum(s1, s2, s2);
+        s2 += t2;
+        return DoubleDouble(s1, s2);
+    }
+
+    inline DoubleDouble operator-(DoubleDouble const& a, DoubleDouble const& b) {
+        return a + -b;
+    }
+
+    inline DoubleDouble operator*(DoubleDouble const& a, DoubleDouble const& b) {
+        double p2;
+        double p1 = Eft::twoProd(a.hi, b.hi, p2);
+        p2 += a.hi * b.lo + a.lo * b.hi;
+        return DoubleDouble(p1, p2);
+    }
+
+    inline DoubleDouble operator*(DoubleDouble const& a, double b) {
+        double p2;
+        double p1 = Eft::twoProd(a.hi, b, p2);
+        p2 += a.lo * b;
+        return DoubleDouble(p1, p2);
+    }
+
+    inline DoubleDouble operator*(double a, DoubleDouble const& b) {
+        return b * a;
+    }
+
+    inline DoubleDouble operator/(DoubleDouble const& a, DoubleDouble const& b) {
+        // 长除法, 每次以最高部分估商
+        double q1 = a.hi / b.hi;
+        DoubleDouble r = a - b * q1;
+        double q2 = r.hi / b.hi;
+        r = r - b * q2;
+        double q3 = r.hi / b.hi;
+        return DoubleDouble(q1, q2) + q3;
+    }
+
+    inline bool operator<(DoubleDouble const& a, DoubleDouble const& b) {
+        return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+    }
+    inline bool operator>(DoubleDouble const& a, DoubleDouble const& b) {
+        return b < a;
+    }
+    inline bool operator<=(DoubleDouble const& a, DoubleDouble const& b) {
+        return !(b < a);
+    }
+    inline bool operator>=(DoubleDouble const& a, DoubleDouble const& b) {
+        return !(a < b);
+    }
+}
+
+#endif // DOUBLEDOUBLE_H
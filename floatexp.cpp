@@ -0,0 +1,91 @@
+#include "floatexp.h"
+#include <QByteArray>
+
+namespace Mandelbrot {
+
+    FloatExp FloatExp::pow10(int k) {
+        FloatExp r(1.0);
+        FloatExp base(10.0);
+        unsigned n = k < 0 ? -(unsigned)k : (unsigned)k;
+        while(n) {
+            if(n & 1) r = r * base;
+            base = base * base;
+            n >>= 1;
+        }
+        return k < 0 ? FloatExp(1.0) / r : r;
+    }
+
+    bool FloatExp::fromString(QString const& str, FloatExp& out) {
+        QByteArray s = str.trimmed().toLatin1();
+        const char* p = s.constData();
+        bool neg = false;
+        if(*p == '+' || *p == '-') {
+            neg = *p == '-';
+            p++;
+        }
+        // 取前19位有效数字为整数尾数, 其余数字只计入十进制指数
+        quint64 digits = 0;
+        int used = 0;
+        int exp10 = 0;
+        bool any = false;
+        bool point = false;
+        for(;; p++) {
+            if(*p == '.' && !point) {
+                point = true;
+                continue;
+            }
+            if(!(*p >= '0' && *p <= '9')) break;
+            any = true;
+            if(digits == 0 && *p == '0') {
+                if(point) exp10--;
+                continue;
+            }
+            if(used < 19) {
+                digits = digits * 10 + (*p - '0');
+                used++;
+                if(point) exp10--;
+            } else if(!point) {
+                exp10++;
+            }
+        }
+        if(!any) return false;
+        if(*p == 'e' || *p == 'E') {
+            p++;
+            bool eneg = false;
+            if(*p == '+' || *p == '-') {
+                eneg = *p == '-';
+                p++;
+            }
+            if(!(*p >= '0' && *p <= '9')) return false;
+            int e = 0;
+            for(; *p >= '0' && *p <= '9'; p++) {
+                e = e * 10 + (*p - '0');
+                if(e > 100000000) return false;
+            }
+            exp10 += eneg ? -e : e;
+        }
+        if(*p != '\0') return false;
+        out = FloatExp((double)digits) * pow10(exp10);
+        if(neg) out = -out;
+        return true;
+    }
+
+    QString FloatExp::toString(int precision) const {
+        if(isZero() || !isFinite() || (e > -1000 && e < 1000)) {
+            return QString::number(toDouble(), 'g', precision);
+        }
+        // 十进制指数k, 尾数为x / 10^k
+        int k = (int)std::floor(e * std::log10(2.0) + std::log10(std::fabs(m)));
+        double mant = (*this / pow10(k)).toDouble();
+        QString text = QString::number(mant, 'g', precision);
+        // 舍入后尾数可能进位到10
+        if(std::fabs(text.toDouble()) >= 10) {
+            k++;
+            mant = (*this / pow10(k)).toDouble();
+            text = QString::number(mant, 'g', precision);
+        }
+        QString exp = QString::number(k < 0 ? -k : k);
+        if(exp.length() < 2) exp = QString("0") + exp;
+        return text + (k < 0 ? "e-" : "e+") + exp;
+    }
+}
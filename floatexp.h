@@ -0,0 +1,153 @@
+#ifndef FLOATEXP_H
+#define FLOATEXP_H
+
+#include <QString>
+#include <QtGlobal>
+#include <cmath>
+#include <cstring>
+
+namespace Mandelbrot {
+
+    /**
+     * @brief 扩展指数浮点数, 值为m 2^e, 1 <= |m| < 2, 零时m = 0, 无穷与NaN时m原样保存且e = INF_EXP
+     * 尾数与double同为53位, 指数另用int保存, 不受double约1e-308的下限限制,
+     * 用作深度缩放时扰动计算的偏移类型; 运算后按位取出尾数的指数完成规格化, 不调用frexp
+     */
+    class FloatExp {
+    public:
+        // INF_EXP大于任何有限值的指数, 加减时不会被有限值吞掉; 两者相加减均不溢出int
+        enum { ZERO_EXP = -0x40000000, INF_EXP = 0x20000000 };
+
+        double m;
+        int e;
+
+        FloatExp() : m(0), e(ZERO_EXP) {}
+        FloatExp(double x) : m(x), e(0) { normalize(); }
+        FloatExp(double m, int e) : m(m), e(e) { normalize(); }
+
+        // 2^n, 要求-1022 <= n <= 1023
+        static double pow2(int n) {
+            quint64 bits = (quint64)(n + 1023) << 52;
+            double r;
+            memcpy(&r, &bits, sizeof(r));
+            return r;
+        }
+
+        void normalize() {
+            if(m == 0) {
+                e = ZERO_EXP;
+                return;
+            }
+            quint64 bits;
+            memcpy(&bits, &m, sizeof(bits));
+            int be = (int)((bits >> 52) & 0x7ff);
+            if(be == 0x7ff) {
+                // 溢出与0/0保持为无穷与NaN
+                e = INF_EXP;
+                return;
+            }
+            if(be == 0) {
+                // 非规格化数先放大
+                m *= pow2(54);
+                e -= 54;
+                memcpy(&bits, &m, sizeof(bits));
+                be = (int)((bits >> 52) & 0x7ff);
+            }
+            e += be - 1023;
+            bits = (bits & ~((quint64)0x7ff << 52)) | ((quint64)1023 << 52);
+            memcpy(&m, &bits, sizeof(m));
+        }
+
+        bool isZero() const { return m == 0; }
+        bool isFinite() const { return e != INF_EXP; }
+
+        // 超出double范围时得到0或无穷
+        double toDouble() const {
+            if(e >= -1022 && e <= 1023) {
+                return m * pow2(e);
+            }
+            return e < -1100 ? 0 : std::ldexp(m, e);
+        }
+
+        FloatExp operator-() const {
+            FloatExp r;
+            r.m = -m;
+            r.e = e;
+            return r;
+        }
+
+        // 10^k, 按二进制幂逐次平方, 相对误差约为log2|k|个ulp
+        static FloatExp pow10(int k);
+
+        // 解析十进制串, 如"1.5e-500", 不依赖区域设置
+        static bool fromString(QString const& str, FloatExp& out);
+        // 在double范围内与QString::number(x, 'g', precision)相同, 否则以同样的格式写出扩展的指数
+        QString toString(int precision = 15) const;
+    };
+
+    inline FloatExp operator+(FloatExp const& a, FloatExp const& b) {
+        int d = a.e - b.e;
+        if(d >= 0) {
+            if(d > 63) return a;
+            return FloatExp(a.m + b.m * FloatExp::pow2(-d), a.e);
+        }
+        if(d < -63) return b;
+        return FloatExp(b.m + a.m * FloatExp::pow2(d), b.e);
+    }
+
+    inline FloatExp operator-(FloatExp const& a, FloatExp const& b) {
+        return a + -b;
+    }
+
+    inline FloatExp operator*(FloatExp const& a, FloatExp const& b) {
+        return FloatExp(a.m * b.m, a.e + b.e);
+    }
+
+    inline FloatExp operator*(FloatExp const& a, double b) {
+        return FloatExp(a.m * b, a.e);
+    }
+
+    inline FloatExp operator*(double a, FloatExp const& b) {
+        return FloatExp(a * b.m, b.e);
+    }
+
+    inline FloatExp operator/(FloatExp const& a, FloatExp const& b) {
+        return FloatExp(a.m / b.m, a.e - b.e);
+    }
+
+    inline FloatExp operator/(FloatExp const& a, double b) {
+        return FloatExp(a.m / b, a.e);
+    }
+
+    inline bool operator<(FloatExp const& a, FloatExp const& b) {
+        return (a - b).m < 0;
+    }
+    inline bool operator>(FloatExp const& a, FloatExp const& b) {
+        return b < a;
+    }
+    inline bool operator<=(FloatExp const& a, FloatExp const& b) {
+        return !(b < a);
+    }
+    inline bool operator>=(FloatExp const& a, FloatExp const& b) {
+        return !(a < b);
+    }
+
+    inline FloatExp sqrt(FloatExp const& x) {
+        if(x.e & 1) {
+            return FloatExp(std::sqrt(2 * x.m), (x.e - 1) / 2);
+        }
+        return FloatExp(std::sqrt(x.m), x.e / 2);
+    }
+
+    /**
+     * @brief 供偏移类型通用的代码使用, double与FloatExp写法一致
+     */
+    inline double toDouble(double x) {
+        return x;
+    }
+    inline double toDouble(FloatExp const& x) {
+        return x.toDouble();
+    }
+}
+
+#endif // FLOATEXP_H
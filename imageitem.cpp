@@ -0,0 +1,30 @@
+#include "imageitem.h"
+#include <QImage>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+ImageItem::ImageItem() : image(NULL) {
+    // 只绘制需要重绘的部分, 大图缩小显示时也不必每次遍历整张图
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+void ImageItem::setImage(QImage const* image) {
+    prepareGeometryChange();
+    this->image = image;
+}
+
+QRectF ImageItem::boundingRect() const {
+    if(!image) {
+        return QRectF();
+    }
+    return QRectF(0, 0, image->width(), image->height());
+}
+
+void ImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    Q_UNUSED(widget)
+    if(!image) {
+        return;
+    }
+    QRectF rect = option->exposedRect & boundingRect();
+    painter->drawImage(rect, *image, rect);
+}
@@ -0,0 +1,26 @@
+#ifndef IMAGEITEM_H
+#define IMAGEITEM_H
+
+#include <QGraphicsItem>
+
+class QImage;
+
+/**
+ * @brief 直接绘制外部QImage的图元, 不转换为QPixmap
+ * 图像由调用方持有并可随时改写, 改写后对相应矩形调用update即可只重绘该部分
+ */
+class ImageItem : public QGraphicsItem {
+private:
+    QImage const* image;
+
+public:
+    ImageItem();
+
+    // 不接管所有权, 显示期间图像须保持有效, 传入NULL则不绘制
+    void setImage(QImage const* image);
+
+    virtual QRectF boundingRect() const;
+    virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+};
+
+#endif // IMAGEITEM_H
@@ -11,7 +11,18 @@
 #include <QClipboard>
 #include <QRegExp>
 #include <QStringListModel>
+#include <QCoreApplication>
+#include <QDir>
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
 #include "timesrender.h"
+#include "perturbation.h"
+#include "doubledouble.h"
+#include "quaddouble.h"
+#include "imageitem.h"
 
 /**
  * @brief 更换输入框错误标记(消去,添加)
@@ -24,15 +35,29 @@ inline static void changeErrorMark(QLineEdit* lineEdit, bool to_set) {
     }
 }
 
+/**
+ * @brief 用户缓存目录下的子目录, 程序目录安装后通常不可写
+ */
+static QString cacheLocation(QString const& name) {
+#if QT_VERSION >= 0x050000
+    QString base = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    QString base = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+    if(base.isEmpty()) {
+        base = QDir::tempPath() + "/" + QCoreApplication::applicationName();
+    }
+    return base + "/" + name;
+}
+
 inline static bool isInteger(QString const& str) {
     bool ok;
     int i = str.toInt(&ok);
     return ok && i > 0;
 }
 inline static bool isNumber(QString const& str) {
-    bool ok;
-    str.toDouble(&ok);
-    return ok;
+    Mandelbrot::FloatExp x;
+    return Mandelbrot::FloatExp::fromString(str, x);
 }
 inline static bool isFilename(QString const& str) {
     if(str.length() == 0) {
@@ -65,20 +90,44 @@ MainWindow::MainWindow(QWidget *parent) :
     scene(new QGraphicsScene()),
     pixmapItem(new QGraphicsPixmapItem()),
     viewCalcMgr(NULL),
-    viewImg(NULL),
-    viewImgReader(NULL),
+    viewTimes(NULL),
+    viewShownTimes(NULL),
+    viewOrbit(NULL),
+    viewShownOrbit(NULL),
+    viewKernel(KERNEL_DOUBLE),
     geneCalcMgr(NULL),
-    geneImg(NULL),
-    geneImgReader(NULL),
-    model(new QStringListModel(strlist))
+    geneTimes(NULL),
+    geneSavedTimes(NULL),
+    geneKernel(KERNEL_DOUBLE),
+    geneItem(new ImageItem()),
+    history(cacheLocation("history"), 0),
+    model(new HistoryModel(strlist, history)),
+    tileStore(cacheLocation("tilecache"), 0),
+    tileCache(0)
 {
     ui->setupUi(this);
+    tileCache.setCapacity(ui->cacheSpinBox->value() * 1024);
+    QStringList notices;
+    if(!tileStore.isWritable()) {
+        ui->storeSpinBox->setEnabled(false);
+        ui->storeGenerateCheckBox->setEnabled(false);
+        notices << QString::fromUtf8("磁盘缓存目录不可写, 已停用: ") + tileStore.getDir();
+    }
+    if(!history.isWritable()) {
+        notices << QString::fromUtf8("历史缓存目录不可写, 超出上限的预览将被丢弃: ") + history.getDir();
+    }
+    ui->noticeLabel->setText(notices.join("; "));
+    on_storeSpinBox_valueChanged(ui->storeSpinBox->value());
+    on_historySpinBox_valueChanged(ui->historySpinBox->value());
     ui->graphicsView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     ui->graphicsView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     ui->graphicsView->setScene(scene);
     scene->addItem(pixmapItem);
+    scene->addItem(geneItem);
+    geneItem->setVisible(false);
 
     ui->historyListView->setModel(model);
+    ui->historyListView->setIconSize(QSize(ViewHistory::THUMBNAIL_WIDTH, ViewHistory::THUMBNAIL_HEIGHT));
 
 //    setMaximumSize(size());
 //    setMinimumSize(size());
@@ -111,7 +160,13 @@ MainWindow::MainWindow(QWidget *parent) :
 }
 
 MainWindow::~MainWindow() {
+    stopViewCalc();
+    stopGeneCalc();
+    delete viewShownTimes;
+    delete viewShownOrbit;
+    delete geneSavedTimes;
     delete model;
+    delete geneItem;
     delete pixmapItem;
     delete scene;
     delete ui;
@@ -122,6 +177,81 @@ void MainWindow::setViewSize(int w, int h) {
     ui->graphicsView->setMinimumSize(w + 2, h + 2);
 }
 
+/**
+ * @brief 视图切回预览图
+ */
+void MainWindow::showPreview() {
+    geneItem->setVisible(false);
+    pixmapItem->setVisible(true);
+}
+
+/**
+ * @brief 新的预览(计算完成或取自历史记录)转为当前显示的预览, 此后平移、放大与提高迭代上限以它为基础
+ */
+void MainWindow::setShownView() {
+    delete viewShownTimes;
+    viewShownTimes = viewTimes;
+    delete viewShownOrbit;
+    viewShownOrbit = viewOrbit;
+    viewShownKey = viewKey;
+    viewShownPos = viewPos;
+    viewTimes = NULL;
+    viewOrbit = NULL;
+}
+
+/**
+ * @brief 为生成中新完成的块着色并只重绘这些块
+ */
+void MainWindow::colorizeGeneTiles() {
+    QVector<Mandelbrot::Tile> tiles;
+    geneCalcMgr->takeFinishedTiles(tiles);
+    for(int i = 0; i < tiles.size(); i++) {
+        Mandelbrot::Tile const& tile = tiles[i];
+        Mandelbrot::colorize(*geneTimes, geneImage, timesRender, tile);
+        geneItem->update(tile.x0, tile.y0, tile.x1 - tile.x0, tile.y1 - tile.y0);
+        geneColoredTiles.append(tile);
+    }
+}
+
+/**
+ * @brief 终止计算中的任务并释放其资源
+ * 管理器延迟删除, 使其已投递但未处理的信号仍能按sender()识别为过期而忽略
+ */
+void MainWindow::stopViewCalc() {
+    if(viewCalcMgr) {
+        viewCalcMgr->disconnect(ui->progressBar);
+        viewCalcMgr->cancel();
+        viewCalcMgr->wait();
+        viewCalcMgr->deleteLater();
+        viewCalcMgr = NULL;
+    }
+    delete viewTimes;
+    viewTimes = NULL;
+    delete viewOrbit;
+    viewOrbit = NULL;
+}
+
+void MainWindow::stopGeneCalc() {
+    if(geneCalcMgr) {
+        geneCalcMgr->disconnect(ui->progressBar);
+        geneCalcMgr->cancel();
+        geneCalcMgr->wait();
+        geneCalcMgr->deleteLater();
+        geneCalcMgr = NULL;
+    }
+    delete geneTimes;
+    geneTimes = NULL;
+}
+
+/**
+ * @brief 按当前着色器为迭代次数缓冲着色
+ */
+QImage MainWindow::colorize(Mandelbrot::TimesBuffer const& buf) {
+    QImage img(buf.width(), buf.height(), QImage::Format_RGB888);
+    Mandelbrot::colorize(buf, img, timesRender, colorPool, ui->threadTotalSpinBox->value());
+    return img;
+}
+
 /**
  * @brief 检查勾选框是否数据勾选饱和
  */
@@ -267,25 +397,22 @@ bool MainWindow::calcFinal(int* pw, int* ph) {
         if(ph) *ph = pheight;
     }
     if(pok && pwidth > 0 && pheight > 0) {
-        double n;
-        bool ok;
+        // 像素间距与宽高按扩展指数解析, 可超出double的范围
+        Mandelbrot::FloatExp n;
         if(ui->pixelCheckBox->isChecked()) {
-            n = ui->pixelLineEdit->text().toDouble(&ok);
-            if(ok) {
-                ui->widthLineEdit->setText(QString::number(n * pwidth, 'g', 15));
-                ui->heightLineEdit->setText(QString::number(n * pheight, 'g', 15));
+            if(Mandelbrot::FloatExp::fromString(ui->pixelLineEdit->text(), n)) {
+                ui->widthLineEdit->setText((n * pwidth).toString(15));
+                ui->heightLineEdit->setText((n * pheight).toString(15));
             }
         } else if(ui->widthCheckBox->isChecked()) {
-            n = ui->widthLineEdit->text().toDouble(&ok);
-            if(ok) {
-                ui->pixelLineEdit->setText(QString::number(n / pwidth, 'g', 15));
-                ui->heightLineEdit->setText(QString::number(n * pheight / pwidth, 'g', 15));
+            if(Mandelbrot::FloatExp::fromString(ui->widthLineEdit->text(), n)) {
+                ui->pixelLineEdit->setText((n / pwidth).toString(15));
+                ui->heightLineEdit->setText((n * pheight / pwidth).toString(15));
             }
         } else if(ui->heightCheckBox->isChecked()) {
-            n = ui->heightLineEdit->text().toDouble(&ok);
-            if(ok) {
-                ui->pixelLineEdit->setText(QString::number(n / pheight, 'g', 15));
-                ui->widthLineEdit->setText(QString::number(n * pwidth / pheight, 'g', 15));
+            if(Mandelbrot::FloatExp::fromString(ui->heightLineEdit->text(), n)) {
+                ui->pixelLineEdit->setText((n / pheight).toString(15));
+                ui->widthLineEdit->setText((n * pwidth / pheight).toString(15));
             }
         }
     }
@@ -485,6 +612,11 @@ void MainWindow::getWH(double& width, double& height) {
     width = ui->widthLineEdit->text().toDouble();
     height = ui->heightLineEdit->text().toDouble();
 }
+bool MainWindow::getWH(Mandelbrot::FloatExp& width, Mandelbrot::FloatExp& height) {
+    return Mandelbrot::FloatExp::fromString(ui->widthLineEdit->text(), width)
+            && Mandelbrot::FloatExp::fromString(ui->heightLineEdit->text(), height)
+            && !width.isZero() && !height.isZero();
+}
 void MainWindow::setWidth(double n) {
     ui->widthLineEdit->setText(QString::number(n, 'g', 15));
 }
@@ -497,6 +629,272 @@ void MainWindow::setPixel(double n) {
 size_t MainWindow::getMaxtimes() {
     return ui->timesSpinBox->value();
 }
+Mandelbrot::CalcOptions MainWindow::getCalcOptions(double pixel_spacing) {
+    Mandelbrot::CalcOptions opt;
+    opt.bulb_check = ui->bulbCheckBox->isChecked();
+    bool ok;
+    double tolerance = ui->periodToleranceLineEdit->text().toDouble(&ok);
+    opt.periodicity = ui->periodCheckBox->isChecked() && ok && tolerance > 0;
+    opt.period_eps = opt.periodicity ? tolerance * pixel_spacing : 0;
+    return opt;
+}
+
+/**
+ * @brief 高精度解析的坐标展开为双双/四双精度
+ */
+inline static void fromBigFixed(Mandelbrot::BigFixed const& b, Mandelbrot::DoubleDouble& x) {
+    double d[2];
+    b.toDoubles(d, 2);
+    x = Mandelbrot::DoubleDouble(d[0], d[1]);
+}
+
+inline static void fromBigFixed(Mandelbrot::BigFixed const& b, Mandelbrot::QuadDouble& x) {
+    double d[4];
+    b.toDoubles(d, 4);
+    x = Mandelbrot::QuadDouble(d[0], d[1], d[2], d[3]);
+}
+
+/**
+ * @brief 以扩展精度类型T直接迭代, 左上角坐标由中心点原文换算, 不经double舍入
+ */
+template<typename T>
+static Mandelbrot::CalcTask* createExtendedTask(Mandelbrot::TimesBuffer* buf, Mandelbrot::ReaderOptions const& ro,
+                                                Mandelbrot::BigFixed const& center_real,
+                                                Mandelbrot::BigFixed const& center_imag, double width, double height) {
+    T cx, cy;
+    fromBigFixed(center_real, cx);
+    fromBigFixed(center_imag, cy);
+    T w(width), h(height);
+    return new Mandelbrot::ReaderCalcTask<T>(
+                Mandelbrot::createImageReader<T>(ro, buf, cx - w * 0.5, cy + h * 0.5, w, h),
+                new Mandelbrot::EscapeKernel<T>());
+}
+
+/**
+ * @brief 扰动计算任务, 偏移类型D为double或FloatExp
+ */
+template<typename D>
+static Mandelbrot::CalcTask* createPerturbationTask(Mandelbrot::TimesBuffer* buf,
+                                                    Mandelbrot::ReaderOptions const& ro,
+                                                    Mandelbrot::BigFixed const& center_real,
+                                                    Mandelbrot::BigFixed const& center_imag,
+                                                    D width, D height, D spacing, bool series, bool bla) {
+    using std::sqrt;
+    Mandelbrot::PerturbationKernel<D>* pk = new Mandelbrot::PerturbationKernel<D>(
+                center_real, center_imag, buf->getMaxTimes());
+    if(series) {
+        pk->enableSeries(width / 2, height / 2, spacing);
+    }
+    if(bla) {
+        pk->enableBla(sqrt(width * width + height * height) / 2);
+    }
+    // 以图像中心为原点, 读取器给出的坐标即偏移dc
+    return new Mandelbrot::ReaderCalcTask<D>(
+                Mandelbrot::createImageReader<D>(ro, buf, -width / 2, height / 2, width, height), pk);
+}
+
+/**
+ * @brief 确定实际使用的计算核心
+ * 自动时按生成图的像素间距与迭代次数选取精度, 预览与生成因此选用同一核心, 不会预览清晰而生成出现马赛克
+ */
+int MainWindow::resolveKernel(Mandelbrot::FloatExp const& width, Mandelbrot::FloatExp const& height) {
+    int kernel = ui->kernelComboBox->currentIndex();
+    if(kernel != KERNEL_AUTO) return kernel;
+    bool ok_w, ok_h;
+    int pw = ui->widthPixelLineEdit->text().toInt(&ok_w);
+    int ph = ui->heightPixelLineEdit->text().toInt(&ok_h);
+    if(!ok_w || !ok_h || pw <= 1 || ph <= 1) {
+        pw = ph = 300;
+    }
+    double spacing = qMin(width / (pw - 1), height / (ph - 1)).toDouble();
+    switch(Mandelbrot::choosePrecision(spacing, getMaxtimes())) {
+    case Mandelbrot::PRECISION_FLOAT:
+        return KERNEL_FLOAT;
+    case Mandelbrot::PRECISION_DOUBLE:
+        return KERNEL_DOUBLE;
+    case Mandelbrot::PRECISION_DOUBLE_DOUBLE:
+        return KERNEL_DOUBLE_DOUBLE;
+    default:
+        return KERNEL_PERTURBATION;
+    }
+}
+
+/**
+ * @brief 按计算核心建立计算任务, 高精度计算时按原文解析中心坐标, 失败返回NULL
+ * 填充方式由界面决定, ro中的其余设置由调用方给出
+ */
+Mandelbrot::CalcTask* MainWindow::createCalc(Mandelbrot::TimesBuffer* buf, int kernel, double lux, double luy,
+                                             Mandelbrot::FloatExp const& width_x,
+                                             Mandelbrot::FloatExp const& height_x, Mandelbrot::ReaderOptions ro) {
+    const double width = width_x.toDouble();
+    const double height = height_x.toDouble();
+    ro.fill = (Mandelbrot::FillMode)ui->fillComboBox->currentIndex();
+    // 放大复用时含推断填充点的块由读取器排除, 不存入缓存
+    const bool use_cache = tileCache.isEnabled();
+    if(use_cache && (kernel == KERNEL_FLOAT || kernel == KERNEL_DOUBLE)) {
+        ro.cache = &tileCache;
+        ro.cache_keyer = new Mandelbrot::PlaneTileKeyer(getCacheKey(kernel, width_x, height_x, *buf),
+                                                        lux, luy, width, height, buf->width(), buf->height());
+    }
+    if(kernel == KERNEL_FLOAT) {
+        return new Mandelbrot::ReaderCalcTask<float>(
+                    Mandelbrot::createImageReader<float>(ro, buf, lux, luy, width, height),
+                    new Mandelbrot::EscapeKernel<float>());
+    }
+    if(kernel == KERNEL_DOUBLE) {
+        return new Mandelbrot::ReaderCalcTask<double>(
+                    Mandelbrot::createImageReader<double>(ro, buf, lux, luy, width, height),
+                    new Mandelbrot::EscapeKernel<double>());
+    }
+
+    Mandelbrot::FloatExp spacing_x = qMin(width_x / max(buf->width() - 1, 1),
+                                          height_x / max(buf->height() - 1, 1));
+    double spacing = spacing_x.toDouble();
+    int limbs = Mandelbrot::BigFixed::limbsForSpacing(spacing_x);
+    if(kernel != KERNEL_PERTURBATION) {
+        limbs = qMax(limbs, 8); // 四双精度约212位
+    }
+    Mandelbrot::BigFixed center_real(limbs), center_imag(limbs);
+    if(!Mandelbrot::BigFixed::fromString(ui->centerRealLineEdit->text(), limbs, center_real)
+            || !Mandelbrot::BigFixed::fromString(ui->centerImagLineEdit->text(), limbs, center_imag)) {
+        ui->noticeLabel->setText(QString::fromUtf8("错误: 高精度计算需要中心点坐标"));
+        return NULL;
+    }
+    if(use_cache) {
+        ro.cache = &tileCache;
+        ro.cache_keyer = new Mandelbrot::BigTileKeyer(getCacheKey(kernel, width_x, height_x, *buf),
+                                                      center_real, center_imag, width_x, height_x,
+                                                      buf->width(), buf->height());
+    }
+    if(kernel == KERNEL_DOUBLE_DOUBLE) {
+        return createExtendedTask<Mandelbrot::DoubleDouble>(buf, ro, center_real, center_imag, width, height);
+    }
+    if(kernel == KERNEL_QUAD_DOUBLE) {
+        return createExtendedTask<Mandelbrot::QuadDouble>(buf, ro, center_real, center_imag, width, height);
+    }
+
+    if(spacing_x < Mandelbrot::FloatExp(Mandelbrot::FLOATEXP_SPACING)) {
+        return createPerturbationTask<Mandelbrot::FloatExp>(buf, ro, center_real, center_imag,
+                                                            width_x, height_x, spacing_x,
+                                                            ui->seriesCheckBox->isChecked(),
+                                                            ui->blaCheckBox->isChecked());
+    }
+    return createPerturbationTask<double>(buf, ro, center_real, center_imag, width, height, spacing,
+                                          ui->seriesCheckBox->isChecked(), ui->blaCheckBox->isChecked());
+}
+
+/**
+ * @brief 坐标与迭代上限以外决定各点迭代次数的全部设置
+ */
+QString MainWindow::getCalcKey(int kernel) {
+    QStringList key;
+    key << QString::number(kernel) << QString::number(ui->fillComboBox->currentIndex())
+        << QString::number(ui->bulbCheckBox->isChecked()) << QString::number(ui->periodCheckBox->isChecked())
+        << ui->periodToleranceLineEdit->text()
+        << QString::number(ui->seriesCheckBox->isChecked()) << QString::number(ui->blaCheckBox->isChecked());
+    return key.join(",");
+}
+
+/**
+ * @brief 除位置、范围与迭代上限外决定预览各点迭代次数的全部设置, 相同时预览缓冲可平移、放大复用或续算
+ */
+QString MainWindow::getViewKey(int kernel, int pw, int ph) {
+    return getCalcKey(kernel) + "," + QString::number(pw) + "," + QString::number(ph);
+}
+
+/**
+ * @brief 上次预览到本次预览的放大倍数, 宽高须同为1至MAX_ZOOM_REUSE的整数倍, 否则返回false
+ */
+bool MainWindow::getZoomScale(ViewPosition const& from, ViewPosition const& to, int& scale) {
+    double rw = (from.width / to.width).toDouble();
+    double rh = (from.height / to.height).toDouble();
+    scale = (int)std::floor(rw + 0.5);
+    return scale >= 1 && scale <= MAX_ZOOM_REUSE
+            && qAbs(rw - scale) < 1e-6 * scale && qAbs(rh - scale) < 1e-6 * scale;
+}
+
+/**
+ * @brief 上次预览放大scale倍到本次预览后的整像素偏移, 新缓冲(scale * x + dx, scale * y + dy)即旧缓冲(x, y),
+ * scale为1时即平移. 偏移须在1/1000像素内对齐整像素且两图有重叠, 否则返回false.
+ * float/double核心按左上角坐标换算, 高精度核心按中心点原文以定点数求差
+ */
+bool MainWindow::getViewShift(int kernel, ViewPosition const& from, ViewPosition const& to, int pw, int ph,
+                              int scale, int& dx, int& dy) {
+    if(pw <= 1 || ph <= 1) return false;
+    Mandelbrot::FloatExp sx = to.width / (pw - 1);
+    Mandelbrot::FloatExp sy = to.height / (ph - 1);
+    double fx, fy;
+    if(kernel == KERNEL_FLOAT || kernel == KERNEL_DOUBLE) {
+        fx = (from.lux - to.lux) / sx.toDouble();
+        fy = (to.luy - from.luy) / sy.toDouble();
+    } else {
+        int limbs = Mandelbrot::BigFixed::limbsForSpacing(qMin(sx, sy));
+        Mandelbrot::BigFixed fr(limbs), fi(limbs), tr(limbs), ti(limbs), d(limbs);
+        if(!Mandelbrot::BigFixed::fromString(from.center_real, limbs, fr)
+                || !Mandelbrot::BigFixed::fromString(from.center_imag, limbs, fi)
+                || !Mandelbrot::BigFixed::fromString(to.center_real, limbs, tr)
+                || !Mandelbrot::BigFixed::fromString(to.center_imag, limbs, ti)) {
+            return false;
+        }
+        // 中心点之差换算到左上角之差, 旧图宽高为新图的scale倍
+        Mandelbrot::BigFixed::sub(fr, tr, d);
+        fx = (d.toFloatExp() / sx).toDouble() - (scale - 1) * (pw - 1) / 2.0;
+        Mandelbrot::BigFixed::sub(ti, fi, d);
+        fy = (d.toFloatExp() / sy).toDouble() - (scale - 1) * (ph - 1) / 2.0;
+    }
+    if(!(fx < pw && fx + scale * (pw - 1) > -1 && fy < ph && fy + scale * (ph - 1) > -1)) return false;
+    dx = (int)std::floor(fx + 0.5);
+    dy = (int)std::floor(fy + 0.5);
+    return qAbs(fx - dx) < 1e-3 && qAbs(fy - dy) < 1e-3;
+}
+
+/**
+ * @brief 块缓存键中块坐标以外的部分: 决定迭代次数的全部设置、迭代上限与两轴的像素间距
+ */
+QString MainWindow::getCacheKey(int kernel, Mandelbrot::FloatExp const& width, Mandelbrot::FloatExp const& height,
+                                Mandelbrot::TimesBuffer const& buf) {
+    QStringList key;
+    key << getCalcKey(kernel) << QString::number((qulonglong)buf.getMaxTimes())
+        << (width / max(buf.width() - 1, 1)).toString(17) << (height / max(buf.height() - 1, 1)).toString(17);
+    return key.join(",");
+}
+
+/**
+ * @brief 加速统计说明, 附在完成提示后
+ */
+QString MainWindow::getStatsString(Mandelbrot::CalcStats const& stats, int kernel,
+                                   Mandelbrot::TimesBuffer const& buf) {
+    QString str = QString::fromUtf8("计算核心:%1%2.").arg(ui->kernelComboBox->itemText(kernel))
+            .arg(ui->kernelComboBox->currentIndex() == KERNEL_AUTO ? QString::fromUtf8("(自动)") : QString());
+    if(stats.tile_hits + stats.tile_misses > 0) {
+        str += QString::fromUtf8("块缓存命中%1/%2.").arg(stats.tile_hits).arg(stats.tile_hits + stats.tile_misses);
+    }
+    quint64 total = (quint64)buf.width() * buf.height();
+    if(stats.filled > 0) {
+        str += QString::fromUtf8("按旧网格填充%1%像素.").arg(100.0 * stats.filled / total, 0, 'f', 1);
+    }
+    if(stats.pixels == 0) return str;
+    if(stats.pixels < total) {
+        str += QString::fromUtf8("实际迭代%1%像素.").arg(100.0 * stats.pixels / total, 0, 'f', 1);
+    }
+    if(kernel == KERNEL_PERTURBATION) {
+        if(stats.skipped > 0) {
+            str += QString::fromUtf8("级数近似跳过%1次.").arg(stats.skipped / stats.pixels);
+        }
+        if(stats.bla_jumps > 0) {
+            str += QString::fromUtf8("BLA平均每段跳过%1次.")
+                    .arg((double)stats.bla_skipped / stats.bla_jumps, 0, 'f', 1);
+        }
+        return str + QString::fromUtf8("重定基平均每点%1次.").arg((double)stats.rebases / stats.pixels, 0, 'f', 2);
+    }
+    if(ui->bulbCheckBox->isChecked()) {
+        str += QString::fromUtf8("心形/圆盘命中%1%.").arg(100.0 * stats.bulb_hits / stats.pixels, 0, 'f', 1);
+    }
+    if(ui->periodCheckBox->isChecked()) {
+        str += QString::fromUtf8("周期检测命中%1%.").arg(100.0 * stats.period_hits / stats.pixels, 0, 'f', 1);
+    }
+    return str;
+}
 
 /**
  * @brief 预览事件
@@ -506,56 +904,135 @@ void MainWindow::on_viewButton_clicked() {
     int real_cnt, imag_cnt, final_cnt, sum;
     countChecked(real_cnt, imag_cnt, final_cnt, sum);
     if(!(real_cnt && imag_cnt && sum)) return;
-    double width, height;
-    getWH(width, height);
-    if(width == 0 || height == 0) return;
+    Mandelbrot::FloatExp width, height;
+    if(!getWH(width, height)) return;
     double lux, luy;
     if(!getLU(lux, luy)) return;
 
-    int pw = 300, ph = 300;
+    // 边长取奇数, 中心恰为像素点, 绕中心整数倍放大时新旧采样点才能重合
+    int pw = 301, ph = 301;
     if(width > height) {
-        ph = pw * height / width;
+        ph = (int)(pw * (height / width).toDouble()) | 1;
     } else {
-        pw = ph * width / height;
+        pw = (int)(ph * (width / height).toDouble()) | 1;
     }
 
-    if(viewImg || viewImgReader || viewCalcMgr) {
-        ui->noticeLabel->setText(QString::fromUtf8("预览图已在计算中,暂不能终止."));
+    // 旧的预览立即终止, 线程留在viewPool中给新任务复用
+    stopViewCalc();
+
+    viewTimes = new Mandelbrot::TimesBuffer(pw, ph, getMaxtimes());
+    viewKernel = resolveKernel(width, height);
+    viewKey = getViewKey(viewKernel, pw, ph);
+    viewPos.lux = lux;
+    viewPos.luy = luy;
+    viewPos.center_real = ui->centerRealLineEdit->text();
+    viewPos.center_imag = ui->centerImagLineEdit->text();
+    viewPos.width = width;
+    viewPos.height = height;
+    viewOrbit = new Mandelbrot::OrbitBuffer(pw, ph);
+    viewCfg = getConfigString();
+
+    // 历史记录中存有同一视图的预览时直接取用, 不再计算; 续算状态不保存, 提高迭代上限时从头计算
+    QTime t;
+    t.start();
+    Mandelbrot::TimesBuffer* cached = history.find(viewCfg, viewKey, viewTimes->getMaxTimes());
+    if(cached) {
+        delete viewTimes;
+        viewTimes = cached;
+        showPreview();
+        setViewSize(pw, ph);
+        pixmapItem->setPixmap(QPixmap::fromImage(colorize(*viewTimes)));
+        setShownView();
+        ui->noticeLabel->setText(QString::fromUtf8("已从历史记录取回预览,用时:%1ms.").arg(t.elapsed()));
         return;
     }
 
-    viewImg = new QImage(pw, ph, QImage::Format_RGB888);
-    viewImgReader = new Mandelbrot::RectangleImageReader<double>(
-                viewImg, lux, luy, width, height, getMaxtimes(), &timesRender);
+    Mandelbrot::ReaderOptions ro;
+    ro.progressive = true;
+    ro.orbit = viewOrbit;
+    ro.cache_persist = true;
+    int scale, dx, dy;
+    if(viewShownTimes && viewKey == viewShownKey && getZoomScale(viewShownPos, viewPos, scale)
+            && getViewShift(viewKernel, viewShownPos, viewPos, pw, ph, scale, dx, dy)) {
+        size_t shown_max = viewShownTimes->getMaxTimes();
+        if(scale > 1 && shown_max == viewTimes->getMaxTimes()) {
+            // 整数倍放大: 与旧采样点重合的点直接取旧值, 旧网格上的集合内部直接填充
+            ro.parent = viewShownTimes;
+            ro.parent_orbit = viewShownOrbit;
+            ro.zoom = scale;
+            ro.zoom_dx = dx;
+            ro.zoom_dy = dy;
+        } else if(scale == 1 && shown_max == viewTimes->getMaxTimes()) {
+            // 与显示中的预览只差整像素平移: 重叠部分直接搬移, 只算新露出的行列
+            Mandelbrot::shiftTimes(*viewShownTimes, *viewTimes, dx, dy);
+            Mandelbrot::shiftOrbit(*viewShownOrbit, *viewOrbit, dx, dy);
+            Mandelbrot::exposedRegions(pw, ph, dx, dy, ro.regions);
+            ro.partial = true;
+        } else if(scale == 1 && shown_max < viewTimes->getMaxTimes() && dx == 0 && dy == 0
+                  && ui->fillComboBox->currentIndex() == Mandelbrot::FILL_EVERY_PIXEL) {
+            // 同一视图提高迭代上限: 已逃逸的点原样保留, 达到旧上限的点从保存的z接着迭代
+            // 矩形细分与边界追踪填充的点没有z, 续算只能把填充的内部逐点重算, 不如按原方式整图重算
+            Mandelbrot::shiftTimes(*viewShownTimes, *viewTimes, 0, 0);
+            *viewOrbit = *viewShownOrbit;
+            ro.resume_from = shown_max;
+        }
+    }
+    Mandelbrot::CalcTask* task = createCalc(viewTimes, viewKernel, lux, luy, width, height, ro);
+    if(!task) {
+        stopViewCalc();
+        return;
+    }
     viewCalcMgr = new CalculatorManager(
-                *viewImgReader, ui->threadTotalSpinBox->value());
+                task, viewPool, ui->threadTotalSpinBox->value(),
+                getCalcOptions((width / max(pw - 1, 1)).toDouble()));
+    QObject::connect(viewCalcMgr, SIGNAL(stageFinished(int, int)),
+                     this, SLOT(onViewcalcmgrStageFinished(int, int)));
     QObject::connect(viewCalcMgr, SIGNAL(finished(int)),
                      this, SLOT(onViewcalcmgrFinished(int)));
     QObject::connect(viewCalcMgr, SIGNAL(progress(int)),
                      ui->progressBar, SLOT(setValue(int)));
+    viewCalcMgr->enableStageSnapshot(viewTimes);
     viewCalcMgr->start();
-    ui->noticeLabel->setText(QString::fromUtf8("预览图计算中..."));
+    ui->noticeLabel->setText(QString::fromUtf8("预览图计算中(%1)...").arg(ui->kernelComboBox->itemText(viewKernel)));
 
-    QString cfg = getConfigString();
-    if(!strlist.contains(cfg)) {
-        strlist << cfg;
+    if(!strlist.contains(viewCfg)) {
+        strlist << viewCfg;
         model->setStringList(strlist);
     }
 }
 
+/**
+ * @brief 预览的一遍粗算完成, 先显示粗略图
+ */
+void MainWindow::onViewcalcmgrStageFinished(int stage, int stage_total) {
+    if(sender() != viewCalcMgr) return; // 已被终止的旧任务
+    // 下一遍已在改写viewTimes, 只着色管理线程在两遍之间复制的副本
+    Mandelbrot::TimesBuffer* snapshot = viewCalcMgr->takeStageSnapshot();
+    if(!snapshot) return; // 排队的前一个信号已取走并显示了最新的副本
+    showPreview();
+    setViewSize(snapshot->width(), snapshot->height());
+    pixmapItem->setPixmap(QPixmap::fromImage(colorize(*snapshot)));
+    delete snapshot;
+    ui->noticeLabel->setText(QString::fromUtf8("预览图计算中(%1),第%2/%3遍...")
+                             .arg(ui->kernelComboBox->itemText(viewKernel)).arg(stage + 2).arg(stage_total));
+}
+
 /**
  * @brief 预览图形计算完成
  */
 void MainWindow::onViewcalcmgrFinished(int ms_time) {
-    setViewSize(viewImg->width(), viewImg->height());
-    ui->noticeLabel->setText(QString::fromUtf8("计算完毕,用时:%1ms.").arg(ms_time));
-    pixmapItem->setPixmap(QPixmap::fromImage(*viewImg));
-    delete viewCalcMgr;
-    viewCalcMgr = NULL;
-    delete viewImgReader;
-    viewImgReader = NULL;
-    delete viewImg;
-    viewImg = NULL;
+    if(sender() != viewCalcMgr) return; // 已被终止的旧任务
+    showPreview();
+    setViewSize(viewTimes->width(), viewTimes->height());
+    ui->noticeLabel->setText(QString::fromUtf8("计算完毕,用时:%1ms.").arg(ms_time)
+                             + getStatsString(viewCalcMgr->getStats(), viewKernel, *viewTimes));
+    QImage img = colorize(*viewTimes);
+    pixmapItem->setPixmap(QPixmap::fromImage(img));
+    // 含推断填入的点时只存缩略图: 历史记录不保存续算状态, 取回后无从区分这些点
+    history.insert(viewCfg, viewKey, *viewTimes, !viewOrbit->hasFilled(), img);
+    model->refresh(viewCfg);
+    setShownView();
+    stopViewCalc();
 }
 
 /**
@@ -566,9 +1043,8 @@ void MainWindow::on_generateButton_clicked() {
     int real_cnt, imag_cnt, final_cnt, sum;
     countChecked(real_cnt, imag_cnt, final_cnt, sum);
     if(!(real_cnt && imag_cnt && sum)) return;
-    double width, height;
-    getWH(width, height);
-    if(width == 0 || height == 0) return;
+    Mandelbrot::FloatExp width, height;
+    if(!getWH(width, height)) return;
     double lux, luy;
     if(!getLU(lux, luy)) return;
 
@@ -585,34 +1061,81 @@ void MainWindow::on_generateButton_clicked() {
         if(pw <= 0 || ph <= 0) return;
     }
 
-    if(geneImg || geneImgReader || geneCalcMgr) {
-        ui->noticeLabel->setText(QString::fromUtf8("图片已在计算中,暂不能终止."));
+    stopGeneCalc();
+    ui->saveButton->setEnabled(false);
+
+    geneTimes = new Mandelbrot::TimesBuffer(pw, ph, getMaxtimes());
+    geneKernel = resolveKernel(width, height);
+    // 生成图的块默认不写入磁盘, 免得一次大图挤掉浏览时积累的块
+    Mandelbrot::ReaderOptions ro;
+    ro.cache_persist = ui->storeGenerateCheckBox->isChecked();
+    Mandelbrot::CalcTask* task = createCalc(geneTimes, geneKernel, lux, luy, width, height, ro);
+    if(!task) {
+        stopGeneCalc();
         return;
     }
-
-    geneImg = new QImage(pw, ph, QImage::Format_RGB888);
-    geneImgReader = new Mandelbrot::RectangleImageReader<double>(
-                geneImg, lux, luy, width, height, getMaxtimes(), &timesRender);
     geneCalcMgr = new CalculatorManager(
-                *geneImgReader, ui->threadTotalSpinBox->value());
+                task, genePool, ui->threadTotalSpinBox->value(),
+                getCalcOptions((width / max(pw - 1, 1)).toDouble()));
     QObject::connect(geneCalcMgr, SIGNAL(progress(int)),
                      ui->progressBar, SLOT(setValue(int)));
+    QObject::connect(geneCalcMgr, SIGNAL(tilesFinished()),
+                     this, SLOT(onGenecalcmgrTilesFinished()));
     QObject::connect(geneCalcMgr, SIGNAL(finished(int)),
                      this, SLOT(onGenecalcmgrFinished(int)));
+    geneCalcMgr->enableTileReport();
+
+    // 完成的块逐块着色到geneImage, 视图按预览的大小缩小显示
+    geneImage = QImage(pw, ph, QImage::Format_RGB888);
+    geneImage.fill(0);
+    geneColoredTiles.clear();
+    geneItem->setImage(&geneImage);
+    double scale = qMin(300.0 / pw, 300.0 / ph);
+    geneItem->setScale(scale);
+    geneItem->update();
+    pixmapItem->setVisible(false);
+    geneItem->setVisible(true);
+    setViewSize(qMax((int)(pw * scale), 1), qMax((int)(ph * scale), 1));
+
     geneCalcMgr->start();
-    ui->noticeLabel->setText(QString::fromUtf8("图片计算中..."));
+    ui->noticeLabel->setText(QString::fromUtf8("图片计算中(%1)...").arg(ui->kernelComboBox->itemText(geneKernel)));
+}
+
+/**
+ * @brief 生成中有块完成, 着色后立即显示
+ */
+void MainWindow::onGenecalcmgrTilesFinished() {
+    if(sender() != geneCalcMgr) return; // 已被终止的旧任务
+    colorizeGeneTiles();
 }
 
 void MainWindow::onGenecalcmgrFinished(int ms_time) {
+    if(sender() != geneCalcMgr) return; // 已被终止的旧任务
     QString filename = ui->filenameLineEdit->text();
-    ui->noticeLabel->setText(QString::fromUtf8("生成完毕,用时:%1ms,已保存到\"%2\".").arg(ms_time).arg(filename));
-    geneImg->save(filename);
-    delete geneCalcMgr;
-    geneCalcMgr = NULL;
-    delete geneImgReader;
-    geneImgReader = NULL;
-    delete geneImg;
-    geneImg = NULL;
+    ui->noticeLabel->setText(QString::fromUtf8("生成完毕,用时:%1ms,已保存到\"%2\".").arg(ms_time).arg(filename)
+                             + getStatsString(geneCalcMgr->getStats(), geneKernel, *geneTimes));
+    // 各块已在计算中着色, 补上最后一批即为完整的生成图
+    colorizeGeneTiles();
+    geneImage.save(filename);
+    delete geneSavedTimes;
+    geneSavedTimes = geneTimes;
+    geneTimes = NULL;
+    stopGeneCalc();
+    ui->saveButton->setEnabled(true);
+}
+
+/**
+ * @brief 保存事件: 把显示中的生成图(可能已换过着色器)保存到文件名一栏的文件
+ */
+void MainWindow::on_saveButton_clicked() {
+    if(!geneSavedTimes || geneCalcMgr) return;
+    QString filename = ui->filenameLineEdit->text();
+    if(!isFilename(filename)) return;
+    if(geneImage.save(filename)) {
+        ui->noticeLabel->setText(QString::fromUtf8("已保存到\"%1\".").arg(filename));
+    } else {
+        ui->noticeLabel->setText(QString::fromUtf8("错误: 无法保存到\"%1\".").arg(filename));
+    }
 }
 
 /**
@@ -864,6 +1387,19 @@ void MainWindow::on_threadTotalSpinBox_valueChanged(int arg1) {
 void MainWindow::on_threadTotalSlider_valueChanged(int value) {
     ui->threadTotalSpinBox->setValue(value);
 }
+void MainWindow::on_cacheSpinBox_valueChanged(int arg1) {
+    tileCache.setCapacity(arg1 * 1024);
+}
+void MainWindow::on_historySpinBox_valueChanged(int arg1) {
+    history.setCapacity((qint64)arg1 * 1024 * 1024);
+}
+void MainWindow::on_storeSpinBox_valueChanged(int arg1) {
+    // 设为0只停用, 不删除已有的块文件
+    if(arg1 > 0) {
+        tileStore.setCapacity((qint64)arg1 * 1024 * 1024);
+    }
+    tileCache.setStore(arg1 > 0 && tileStore.isWritable() ? &tileStore : NULL);
+}
 
 void MainWindow::on_timesSpinBox_valueChanged(int arg1) {
     arg1 = arg1;
@@ -1092,6 +1628,27 @@ void MainWindow::on_editSenderPushButton_clicked() {
         QString errstr = timesRender.read_string(ui->shaderTextEdit->toPlainText());
         ui->shaderErrorLabel->setText(errstr);
         if(errstr.length() == 0) { // 成功
+            // 已有迭代次数直接重新着色, 无需重新计算
+            QTime t;
+            t.start();
+            if(viewShownTimes) {
+                pixmapItem->setPixmap(QPixmap::fromImage(colorize(*viewShownTimes)));
+            }
+            if(geneCalcMgr) {
+                // 生成中只有已取出的块计算完毕, 只对这些块改用新着色器; 其余块仍在计算, 完成后照常着色
+                for(int i = 0; i < geneColoredTiles.size(); i++) {
+                    Mandelbrot::colorize(*geneTimes, geneImage, timesRender, geneColoredTiles[i]);
+                }
+                geneItem->update();
+            }
+            if(geneSavedTimes && !geneCalcMgr) {
+                // 只改内存中的生成图, 写入文件留给"保存"
+                geneImage = colorize(*geneSavedTimes);
+                geneItem->update();
+                ui->noticeLabel->setText(QString::fromUtf8("已重新着色,用时:%1ms,生成图未保存.").arg(t.elapsed()));
+            } else if(viewShownTimes) {
+                ui->noticeLabel->setText(QString::fromUtf8("已重新着色,用时:%1ms.").arg(t.elapsed()));
+            }
             ui->editSenderPushButton->setText(QString::fromUtf8("编辑着色器"));
             ui->shaderTextEdit->setVisible(false);
             ui->shaderLabel->setVisible(false);
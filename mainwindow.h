@@ -4,12 +4,15 @@
 #include <QMainWindow>
 #include <mandelbrot.h>
 #include "calculatormanager.h"
+#include "floatexp.h"
 #include "timesrender.h"
+#include "viewhistory.h"
 
 class QGraphicsScene;
 class QGraphicsLineItem;
 class QCheckBox;
 class QGraphicsPixmapItem;
+class ImageItem;
 class QStringListModel;
 class QModelIndex;
 
@@ -72,16 +75,22 @@ private slots:
     void on_centerRealLineEdit_textChanged(const QString &arg1);
     void on_centerImagLineEdit_textChanged(const QString &arg1);
     void on_generateButton_clicked();
+    void on_saveButton_clicked();
     void on_getScreenSizePushButton_clicked();
     void on_threadTotalSlider_valueChanged(int value);
     void on_timespowerSlider_valueChanged(int value);
     void on_timesSpinBox_valueChanged(int arg1);
     void on_threadTotalSpinBox_valueChanged(int arg1);
+    void on_cacheSpinBox_valueChanged(int arg1);
+    void on_storeSpinBox_valueChanged(int arg1);
+    void on_historySpinBox_valueChanged(int arg1);
     void on_getNiceFilenamePushButton_clicked();
     void on_copyConfigPushButton_clicked();
     void on_pasteConfigPushButton_clicked();
 
+    void onViewcalcmgrStageFinished(int stage, int stage_total);
     void onViewcalcmgrFinished(int ms_time);
+    void onGenecalcmgrTilesFinished();
     void onGenecalcmgrFinished(int ms_time);
 
     void on_openHistoryPushButton_clicked();
@@ -90,24 +99,74 @@ private slots:
     void on_editSenderPushButton_clicked();
 
 private:
+    // 计算核心下拉框的选项
+    enum KernelIndex {
+        KERNEL_AUTO,
+        KERNEL_FLOAT,
+        KERNEL_DOUBLE,
+        KERNEL_DOUBLE_DOUBLE,
+        KERNEL_QUAD_DOUBLE,
+        KERNEL_PERTURBATION
+    };
+
+    /**
+     * @brief 预览缓冲对应的视图位置与范围, 平移与放大时据此换算像素偏移
+     */
+    struct ViewPosition {
+        double lux;
+        double luy;
+        QString center_real;
+        QString center_imag;
+        Mandelbrot::FloatExp width;
+        Mandelbrot::FloatExp height;
+    };
+
+    // 放大复用的最大倍数, 更大时旧采样点过疏
+    enum { MAX_ZOOM_REUSE = 8 };
+
     Ui::MainWindow *ui;
     QGraphicsScene* scene;
     QGraphicsPixmapItem* pixmapItem;
 
+    QThreadPool viewPool;
+    QThreadPool genePool;
+    QThreadPool colorPool;
+
     CalculatorManager* viewCalcMgr;
-    QImage* viewImg;
-    Mandelbrot::RectangleImageReader<double>* viewImgReader;
+    Mandelbrot::TimesBuffer* viewTimes;
+    Mandelbrot::TimesBuffer* viewShownTimes; // 当前显示的预览, 更换着色器时重新着色
+    Mandelbrot::OrbitBuffer* viewOrbit; // 计算中预览的续算状态
+    Mandelbrot::OrbitBuffer* viewShownOrbit; // 当前显示的预览的续算状态, 提高迭代上限时接着迭代
+    int viewKernel; // 预览实际使用的计算核心
+    QString viewKey; // 计算中预览除位置、范围与迭代上限外的设置
+    ViewPosition viewPos;
+    QString viewCfg; // 计算中预览的配置串, 完成后按此存入历史记录
+    QString viewShownKey; // 当前显示的预览除位置、范围与迭代上限外的设置
+    ViewPosition viewShownPos;
 
     CalculatorManager* geneCalcMgr;
-    QImage* geneImg;
-    Mandelbrot::RectangleImageReader<double>* geneImgReader;
-
+    Mandelbrot::TimesBuffer* geneTimes;
+    Mandelbrot::TimesBuffer* geneSavedTimes; // 最近生成完毕的图, 更换着色器时据此重新着色
+    int geneKernel;
+    QImage geneImage; // 生成图, 计算中逐块着色, 完成后直接保存
+    ImageItem* geneItem; // 缩小显示geneImage
+    QVector<Mandelbrot::Tile> geneColoredTiles; // 生成中已完成并着色的块, 更换着色器时只重新着色这些块
+
+    ViewHistory history; // 历史记录中各预览的迭代次数与缩略图
     QStringList strlist;
-    QStringListModel* model;
+    HistoryModel* model;
 
     TimesRender timesRender;
+    Mandelbrot::TileStore tileStore; // 磁盘块缓存, 程序重启后仍可取用
+    Mandelbrot::TileCache tileCache; // 预览与生成共用
 
     void setViewSize(int w, int h);
+    void showPreview();
+    void setShownView();
+    void colorizeGeneTiles();
+    void stopViewCalc();
+    void stopGeneCalc();
+    QImage colorize(Mandelbrot::TimesBuffer const& buf);
     void countChecked(int& real_cnt, int& imag_cnt, int& final_cnt, int& s);
     void lockCheckBox();
     void calc();
@@ -125,10 +184,24 @@ private:
     void setYM(double n);
     void setYU(double n);
     void getWH(double& width, double& height);
+    bool getWH(Mandelbrot::FloatExp& width, Mandelbrot::FloatExp& height);
     void setWidth(double n);
     void setHeight(double n);
     void setPixel(double n);
     size_t getMaxtimes();
+    Mandelbrot::CalcOptions getCalcOptions(double pixel_spacing);
+    int resolveKernel(Mandelbrot::FloatExp const& width, Mandelbrot::FloatExp const& height);
+    Mandelbrot::CalcTask* createCalc(Mandelbrot::TimesBuffer* buf, int kernel, double lux, double luy,
+                                     Mandelbrot::FloatExp const& width, Mandelbrot::FloatExp const& height,
+                                     Mandelbrot::ReaderOptions ro);
+    QString getCalcKey(int kernel);
+    QString getViewKey(int kernel, int pw, int ph);
+    bool getZoomScale(ViewPosition const& from, ViewPosition const& to, int& scale);
+    bool getViewShift(int kernel, ViewPosition const& from, ViewPosition const& to, int pw, int ph, int scale,
+                      int& dx, int& dy);
+    QString getCacheKey(int kernel, Mandelbrot::FloatExp const& width, Mandelbrot::FloatExp const& height,
+                        Mandelbrot::TimesBuffer const& buf);
+    QString getStatsString(Mandelbrot::CalcStats const& stats, int kernel, Mandelbrot::TimesBuffer const& buf);
 };
 
 #endif // MAINWINDOW_H
@@ -1 +1,137 @@
 #include "mandelbrot.h"
+#include <QSemaphore>
+#include <cmath>
+
+namespace Mandelbrot {
+
+    static void colorizeRect(TimesBuffer const& buf, QImage& img, Render& render, int x0, int y0, int x1, int y1) {
+        uchar* bits = img.bits();
+        int bytes_per_line = img.bytesPerLine();
+        for(int y = y0; y < y1; y++) {
+            const quint32* times = buf.constScanLine(y);
+            uchar* row_data = bits + y * bytes_per_line + x0 * 3;
+            for(int x = x0; x < x1; x++, row_data += 3) {
+                QRgb rgb = render.getPixelColor(times[x]);
+                row_data[2] = rgb & 0xff;
+                row_data[1] = (rgb >> 8) & 0xff;
+                row_data[0] = (rgb >> 16) & 0xff;
+            }
+        }
+    }
+
+    /**
+     * @brief 着色一段连续的行
+     */
+    class ColorizeTask : public QRunnable {
+    private:
+        TimesBuffer const& buf;
+        QImage& img;
+        Render& render;
+        const int y0;
+        const int y1;
+        QSemaphore& done;
+
+    public:
+        ColorizeTask(TimesBuffer const& buf, QImage& img, Render& render, int y0, int y1, QSemaphore& done) :
+            buf(buf), img(img), render(render), y0(y0), y1(y1), done(done) {
+        }
+
+        virtual void run() {
+            colorizeRect(buf, img, render, 0, y0, buf.width(), y1);
+            done.release();
+        }
+    };
+
+    void colorize(TimesBuffer const& buf, QImage& img, Render& render, QThreadPool& pool, int thread_total) {
+        // 先在调用线程分离图像数据, 各任务再并发写入互不重叠的行
+        img.bits();
+        int h = buf.height();
+        render.prepare(buf.getMaxTimes());
+        if(thread_total < 1) thread_total = 1;
+        if(thread_total > h) thread_total = qMax(h, 1);
+        QSemaphore done;
+        for(int i = 0; i < thread_total; i++) {
+            pool.start(new ColorizeTask(buf, img, render,
+                                        h * i / thread_total, h * (i + 1) / thread_total, done));
+        }
+        // 只等待本次着色的任务, 不受同一线程池中其他任务影响
+        done.acquire(thread_total);
+    }
+
+    void colorize(TimesBuffer const& buf, QImage& img, Render& render, Tile const& tile) {
+        render.prepare(buf.getMaxTimes());
+        colorizeRect(buf, img, render, tile.x0, tile.y0, tile.x1, tile.y1);
+    }
+
+    void shiftTimes(TimesBuffer const& src, TimesBuffer& dst, int dx, int dy) {
+        const int w = dst.width();
+        const int h = dst.height();
+        const int x0 = qMax(dx, 0);
+        const int x1 = qMin(w + dx, w);
+        if(x0 >= x1) {
+            return;
+        }
+        for(int y = qMax(dy, 0); y < qMin(h + dy, h); y++) {
+            memcpy(dst.bits() + y * w + x0, src.constScanLine(y - dy) + x0 - dx, (x1 - x0) * sizeof(quint32));
+        }
+    }
+
+    void shiftOrbit(OrbitBuffer const& src, OrbitBuffer& dst, int dx, int dy) {
+        const int w = dst.width();
+        const int h = dst.height();
+        const int e = 2 * src.elemSize();
+        dst.setElemSize(src.elemSize());
+        memset(dst.stateBits(), OrbitBuffer::ORBIT_NONE, w * h);
+        const int x0 = qMax(dx, 0);
+        const int x1 = qMin(w + dx, w);
+        if(x0 >= x1) {
+            return;
+        }
+        for(int y = qMax(dy, 0); y < qMin(h + dy, h); y++) {
+            const int s = (y - dy) * w + x0 - dx;
+            const int d = y * w + x0;
+            memcpy(dst.stateBits() + d, src.constStateBits() + s, x1 - x0);
+            memcpy(dst.zBits() + d * e, src.constZBits() + s * e, (x1 - x0) * e);
+        }
+    }
+
+    void exposedRegions(int width, int height, int dx, int dy, QVector<Tile>& regions) {
+        regions.clear();
+        // 左右露出的整列
+        int cx0 = 0, cx1 = 0;
+        if(dx > 0) {
+            cx1 = qMin(dx, width);
+        } else if(dx < 0) {
+            cx0 = qMax(width + dx, 0);
+            cx1 = width;
+        }
+        if(cx0 < cx1) {
+            Tile t = {cx0, 0, cx1, height};
+            regions.append(t);
+        }
+        // 上下露出的行, 除去已含在整列中的部分
+        int ry0 = 0, ry1 = 0;
+        if(dy > 0) {
+            ry1 = qMin(dy, height);
+        } else if(dy < 0) {
+            ry0 = qMax(height + dy, 0);
+            ry1 = height;
+        }
+        int rx0 = dx > 0 ? cx1 : 0;
+        int rx1 = dx < 0 ? cx0 : width;
+        if(ry0 < ry1 && rx0 < rx1) {
+            Tile t = {rx0, ry0, rx1, ry1};
+            regions.append(t);
+        }
+    }
+
+    Precision choosePrecision(double pixel_spacing, size_t max_times) {
+        if(!(pixel_spacing > 0)) return PRECISION_PERTURBATION;
+        double bits = std::log(2 / pixel_spacing) / std::log(2.0)
+                + std::log((double)qMax(max_times, (size_t)2)) / std::log(2.0);
+        if(bits <= 24) return PRECISION_FLOAT;
+        if(bits <= 53) return PRECISION_DOUBLE;
+        if(bits <= 106) return PRECISION_DOUBLE_DOUBLE;
+        return PRECISION_PERTURBATION;
+    }
+}
@@ -2,94 +2,250 @@
 #define MANDELBROT_H
 
 #include <iostream>
+#include <cstring>
 #include <QDebug>
 #include <QImage>
 #include <QThread>
 #include <QVector>
+#include <QByteArray>
 #include <QRunnable>
 #include <QThreadPool>
 #include <QMutex>
+#include <QSet>
+#include <QAtomicInt>
 #include <QRgb>
+#include "simdkernel.h"
+#include "tilescheduler.h"
+#include "tilecache.h"
 
 namespace Mandelbrot {
 
+    /**
+     * @brief 读取原子整数(兼容Qt4/Qt5)
+     */
+    inline int atomicLoad(QAtomicInt const& a) {
+#if QT_VERSION >= 0x050000
+        return a.load();
+#else
+        return a;
+#endif
+    }
+
+    /**
+     * @brief 协作式取消标记, 计算线程每算完CANCEL_CHUNK个点检查一次
+     */
+    enum { CANCEL_CHUNK = 16 };
+
+    class CancelToken {
+    private:
+        QAtomicInt cancelled;
+    public:
+        CancelToken() : cancelled(0) {}
+        void cancel() {
+            cancelled.fetchAndStoreOrdered(1);
+        }
+        bool isCancelled() const {
+            return atomicLoad(cancelled) != 0;
+        }
+    };
+
+    /**
+     * @brief 着色器, prepare在着色开始前于单线程中调用, 建好0..max_times的色表;
+     * 此后getPixelColor只读色表, 可被多线程无锁并发调用
+     */
     class Render {
     public:
+        virtual void prepare(size_t max_times) = 0;
         virtual QRgb getPixelColor(size_t times) = 0;
     };
 
-    class Writer {
-    public:
-        virtual void set(size_t final_times) = 0;
+    /**
+     * @brief 图像中的矩形块, 范围为[x0, x1) x [y0, y1)
+     */
+    struct Tile {
+        enum { SIZE = 64 };
+        int x0;
+        int y0;
+        int x1;
+        int y1;
     };
 
+    template<typename T>
+    class Kernel;
+    struct CalcOptions;
+    struct CalcStats;
+
+    /**
+     * @brief 将图像划分为块, 同一块只交给一个计算线程, 块内读写无需加锁
+     */
     template<typename T>
     class Reader {
     public:
-        virtual int getProgress() = 0;
-        virtual Writer* get(T& c_real, T& c_imag, size_t& max_times) = 0;
+        virtual ~Reader() {}
+        virtual size_t getMaxTimes() = 0;
+        virtual int getTileCount() = 0;
+        virtual void getTile(int index, Tile& tile) = 0;
+        // 取单点坐标
+        virtual void getPoint(int x, int y, T& c_real, T& c_imag) = 0;
+        // 取块内第y行各点坐标
+        virtual void getRow(Tile const& tile, int y, T* c_real, T* c_imag) = 0;
+        // 写入块内第y行各点迭代次数
+        virtual void setRow(Tile const& tile, int y, const size_t* times) = 0;
+        // 计算一个块并写回, 默认逐行逐点计算, 子类可换用其他填充策略; 被取消时返回false
+        virtual bool calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                              CalcOptions const& opt, CalcStats& stats);
+        // 分遍计算的遍数, 各遍依次对全部块调用calcTile
+        virtual int getStageCount() {
+            return 1;
+        }
+        virtual void setStage(int stage) {
+            Q_UNUSED(stage)
+        }
+        // 一遍的全部块算完后由管理线程调用, 此时没有计算线程在运行
+        virtual void finishStage() {}
     };
 
-    class RectangleImageWriter : public Writer {
+    /**
+     * @brief 迭代次数缓冲, 计算与着色分离, 更换着色器时只需重新着色
+     */
+    class TimesBuffer {
     private:
-        unsigned char* const row_data;
+        const int pwidth;
+        const int pheight;
         const size_t max_times;
-        Render* const render;
+        QVector<quint32> data;
+    public:
+        TimesBuffer(int width, int height, size_t max_times) :
+            pwidth(width), pheight(height), max_times(max_times), data(width * height) {
+        }
+        int width() const { return pwidth; }
+        int height() const { return pheight; }
+        size_t getMaxTimes() const { return max_times; }
+        quint32* bits() { return data.data(); }
+        const quint32* constScanLine(int y) const { return data.constData() + y * pwidth; }
+    };
 
+    /**
+     * @brief 续算状态, 与同尺寸的迭代次数缓冲配对: 达到迭代上限的点保存最终z,
+     * 提高迭代上限时只需从这里接着迭代. z按核心的数值类型逐点存放, 实部虚部相邻
+     */
+    class OrbitBuffer {
+    public:
+        enum State {
+            ORBIT_NONE = 0, // 未保存z, 续算时从z = 0重算
+            ORBIT_RESUMABLE, // z有效
+            ORBIT_INSIDE, // 已判定在集合内, 不再迭代
+            ORBIT_FILLED // 放大复用时按旧网格推断填入, 未经计算, 不能当作算得的值再次复用
+        };
+    private:
+        int pwidth;
+        int pheight;
+        int elem_size;
+        QVector<quint8> state;
+        QByteArray z;
     public:
-        RectangleImageWriter(unsigned char* row_data, size_t max_times, Render* render) :
-            row_data(row_data), max_times(max_times), render(render) {
+        OrbitBuffer(int width, int height) :
+            pwidth(width), pheight(height), elem_size(0), state(width * height, ORBIT_NONE), z() {
         }
-        virtual void set(size_t final_times) {
-            QRgb rgb;
-            rgb = render->getPixelColor(final_times);
-            row_data[2] = rgb & 0xff;
-            row_data[1] = (rgb >> 8) & 0xff;
-            row_data[0] = (rgb >> 16) & 0xff;
+        int width() const { return pwidth; }
+        int height() const { return pheight; }
+        quint8* stateBits() { return state.data(); }
+        const quint8* constStateBits() const { return state.constData(); }
+        int elemSize() const { return elem_size; }
+        const char* constZBits() const { return z.constData(); }
+        char* zBits() { return z.data(); }
+        // 按数值类型的大小分配z, 大小改变时清空全部状态
+        void setElemSize(int size) {
+            if(elem_size != size) {
+                elem_size = size;
+                z = QByteArray(pwidth * pheight * 2 * size, 0);
+                state.fill(ORBIT_NONE);
+            }
+        }
+        // 取按类型T存放的z, 须在计算开始前于单线程中调用
+        template<typename T>
+        T* zData() {
+            setElemSize(sizeof(T));
+            return reinterpret_cast<T*>(z.data());
+        }
+        // 是否含推断填入的点
+        bool hasFilled() const {
+            return state.contains(ORBIT_FILLED);
         }
     };
 
+    /**
+     * @brief 并行着色: 按着色器将迭代次数映射到RGB888图像, img尺寸须与buf一致
+     */
+    void colorize(TimesBuffer const& buf, QImage& img, Render& render, QThreadPool& pool, int thread_total);
+    /**
+     * @brief 只在调用线程中为一个块着色, 用于计算中逐块显示
+     */
+    void colorize(TimesBuffer const& buf, QImage& img, Render& render, Tile const& tile);
+
+    /**
+     * @brief 平移复用: 将src平移(dx, dy)像素复制到同尺寸的dst, 即dst(x + dx, y + dy) = src(x, y)
+     */
+    void shiftTimes(TimesBuffer const& src, TimesBuffer& dst, int dx, int dy);
+    /**
+     * @brief 续算状态随迭代次数一同平移, dst中未覆盖的点为ORBIT_NONE
+     */
+    void shiftOrbit(OrbitBuffer const& src, OrbitBuffer& dst, int dx, int dy);
+    /**
+     * @brief 平移(dx, dy)后新露出的至多两个互不重叠的矩形
+     */
+    void exposedRegions(int width, int height, int dx, int dy, QVector<Tile>& regions);
+
     template<typename T>
     class RectangleImageReader : public Reader<T> {
-    private:
-        QImage* img;
+    protected:
+        quint32* const data;
         const T lux;
         const T luy;
         const T width;
         const T height;
         const int pwidth;
         const int pheight;
-        int x;
-        int y;
+        const int tiles_x;
+        const int tile_total;
         const size_t max_times;
-        QMutex mutex;
-        Render* const render;
     public:
-        RectangleImageReader(QImage* img, T lux, T luy, T width, T height, size_t max_times, Render* render) :
-            img(img), lux(lux), luy(luy), width(width), height(height),
-            pwidth(img->width()), pheight(img->height()),
-            x(0), y(0), max_times(max_times), mutex(), render(render) {
+        RectangleImageReader(TimesBuffer* buf, T lux, T luy, T width, T height) :
+            data(buf->bits()),
+            lux(lux), luy(luy), width(width), height(height),
+            pwidth(buf->width()), pheight(buf->height()),
+            tiles_x((pwidth + Tile::SIZE - 1) / Tile::SIZE),
+            tile_total(tiles_x * ((pheight + Tile::SIZE - 1) / Tile::SIZE)),
+            max_times(buf->getMaxTimes()) {
         }
-        virtual int getProgress() {
-            return (y * pwidth + x) * 100 / (pwidth * pheight);
+        virtual size_t getMaxTimes() {
+            return max_times;
         }
-        virtual Writer* get(T& c_real, T& c_imag, size_t& max_times) {
-            mutex.lock();
-            if(x >= pwidth || y >= pheight) {
-                mutex.unlock();
-                return NULL;
-            }
+        virtual int getTileCount() {
+            return tile_total;
+        }
+        virtual void getTile(int index, Tile& tile) {
+            tile.x0 = index % tiles_x * Tile::SIZE;
+            tile.y0 = index / tiles_x * Tile::SIZE;
+            tile.x1 = qMin(tile.x0 + (int)Tile::SIZE, pwidth);
+            tile.y1 = qMin(tile.y0 + (int)Tile::SIZE, pheight);
+        }
+        virtual void getPoint(int x, int y, T& c_real, T& c_imag) {
             c_real = width * x / (T)(pwidth - 1) + lux;
             c_imag = height * y / (T)(pheight - 1) - luy;
-            Writer* w = new RectangleImageWriter(img->scanLine(y) + x * 3, this->max_times, render);
-            x++;
-            if(x >= pwidth) {
-                x = 0;
-                y++;
+        }
+        virtual void getRow(Tile const& tile, int y, T* c_real, T* c_imag) {
+            T ci = height * y / (T)(pheight - 1) - luy;
+            for(int x = tile.x0; x < tile.x1; x++) {
+                c_real[x - tile.x0] = width * x / (T)(pwidth - 1) + lux;
+                c_imag[x - tile.x0] = ci;
+            }
+        }
+        virtual void setRow(Tile const& tile, int y, const size_t* times) {
+            quint32* row_data = data + y * pwidth + tile.x0;
+            for(int x = tile.x0; x < tile.x1; x++) {
+                row_data[x - tile.x0] = (quint32)times[x - tile.x0];
             }
-            max_times = this->max_times;
-            mutex.unlock();
-            return w;
         }
     };
 
@@ -109,27 +265,1324 @@ namespace Mandelbrot {
         return max_times;
     }
 
+    /**
+     * @brief 带周期检测(Brent)的迭代: 在2的幂次迭代处记录z, 此后z与记录值
+     * 实部虚部之差均小于period_eps即认为轨道已成环, 判为集合内并返回max_times
+     */
+    template<typename T>
+    size_t calc(T c_real, T c_imag, size_t max_times, T period_eps, bool& periodic) {
+        T z_real = 0;
+        T z_imag = 0;
+        T saved_real = 0;
+        T saved_imag = 0;
+        size_t check = 1;
+        size_t step = 0;
+        periodic = false;
+        for(size_t times = 0; times < max_times; times++) {
+            T nz_real = z_real * z_real - z_imag * z_imag + c_real;
+            T nz_imag = 2 * z_real * z_imag + c_imag;
+            z_real = nz_real;
+            z_imag = nz_imag;
+            if(z_real * z_real + z_imag * z_imag > 4) {
+                return times;
+            }
+            if(qAbs(z_real - saved_real) < period_eps && qAbs(z_imag - saved_imag) < period_eps) {
+                periodic = true;
+                return max_times;
+            }
+            if(++step == check) {
+                step = 0;
+                check <<= 1;
+                saved_real = z_real;
+                saved_imag = z_imag;
+            }
+        }
+        return max_times;
+    }
+
+    /**
+     * @brief 从z出发的续算迭代, 结束时z为最终值, 计数同calc; 周期检测以起点为首个记录点重新开始,
+     * 与从z = 0一次算完相比, 容差内命中的时机可能不同
+     */
+    template<typename T>
+    size_t calcFrom(T c_real, T c_imag, T& z_real, T& z_imag, size_t max_times, T period_eps, bool& periodic) {
+        T saved_real = z_real;
+        T saved_imag = z_imag;
+        size_t check = 1;
+        size_t step = 0;
+        periodic = false;
+        for(size_t times = 0; times < max_times; times++) {
+            T nz_real = z_real * z_real - z_imag * z_imag + c_real;
+            T nz_imag = 2 * z_real * z_imag + c_imag;
+            z_real = nz_real;
+            z_imag = nz_imag;
+            if(z_real * z_real + z_imag * z_imag > 4) {
+                return times;
+            }
+            if(period_eps > 0) {
+                if(qAbs(z_real - saved_real) < period_eps && qAbs(z_imag - saved_imag) < period_eps) {
+                    periodic = true;
+                    return max_times;
+                }
+                if(++step == check) {
+                    step = 0;
+                    check <<= 1;
+                    saved_real = z_real;
+                    saved_imag = z_imag;
+                }
+            }
+        }
+        return max_times;
+    }
+
+    /**
+     * @brief 逐点续算一行, 周期检测命中的点z实部写为INSIDE_MARK, 返回命中的点数
+     */
+    template<typename T>
+    int calcRowFrom(const T* c_real, const T* c_imag, T* z_real, T* z_imag, size_t* times, int n,
+                    size_t max_times, T period_eps) {
+        int periodic_total = 0;
+        for(int i = 0; i < n; i++) {
+            bool periodic;
+            times[i] = calcFrom<T>(c_real[i], c_imag[i], z_real[i], z_imag[i], max_times, period_eps, periodic);
+            if(periodic) {
+                z_real[i] = (T)INSIDE_MARK;
+                periodic_total++;
+            }
+        }
+        return periodic_total;
+    }
+
+    /**
+     * @brief 计算一行n个点, period_eps > 0时启用周期检测, 返回因周期检测提前结束的点数
+     * z_real/z_imag非NULL时从给定的z续算并写回最终z. double与float交给向量核心批量计算
+     */
+    template<typename T>
+    int calcRow(const T* c_real, const T* c_imag, size_t* times, int n, size_t max_times, T period_eps,
+                T* z_real = NULL, T* z_imag = NULL) {
+        if(z_real) {
+            return calcRowFrom<T>(c_real, c_imag, z_real, z_imag, times, n, max_times, period_eps);
+        }
+        int periodic_total = 0;
+        for(int i = 0; i < n; i++) {
+            if(period_eps > 0) {
+                bool periodic;
+                times[i] = calc<T>(c_real[i], c_imag[i], max_times, period_eps, periodic);
+                if(periodic) periodic_total++;
+            } else {
+                times[i] = calc<T>(c_real[i], c_imag[i], max_times);
+            }
+        }
+        return periodic_total;
+    }
+
+    template<>
+    inline int calcRow<double>(const double* c_real, const double* c_imag, size_t* times, int n, size_t max_times, double period_eps,
+                           double* z_real, double* z_imag) {
+        return calcBatch(c_real, c_imag, times, n, max_times, period_eps, z_real, z_imag);
+    }
+
+    template<>
+    inline int calcRow<float>(const float* c_real, const float* c_imag, size_t* times, int n, size_t max_times, float period_eps,
+                           float* z_real, float* z_imag) {
+        return calcBatch(c_real, c_imag, times, n, max_times, period_eps, z_real, z_imag);
+    }
+
+    /**
+     * @brief 自动选择的计算精度, 按开销从低到高排列
+     */
+    enum Precision {
+        PRECISION_FLOAT,
+        PRECISION_DOUBLE,
+        PRECISION_DOUBLE_DOUBLE,
+        PRECISION_PERTURBATION
+    };
+
+    /**
+     * @brief 选取不出现马赛克与噪点的最便宜精度
+     * 迭代中|z|不超过2, 分辨像素需要log2(2 / pixel_spacing)位, 舍入误差随迭代放大,
+     * 再留log2(max_times)位余量, 超过双双精度的106位则改用扰动计算
+     */
+    Precision choosePrecision(double pixel_spacing, size_t max_times);
+
+    /**
+     * @brief 逃逸核心的加速选项
+     */
+    struct CalcOptions {
+        bool bulb_check; // 主心形与周期2圆盘内的点直接判为集合内
+        bool periodicity; // 周期检测
+        double period_eps; // 周期检测容差, 由像素间距乘以系数得出
+
+        CalcOptions() : bulb_check(true), periodicity(false), period_eps(0) {}
+    };
+
+    /**
+     * @brief 计算统计, 各线程分别累加, 结束后合并
+     */
+    struct CalcStats {
+        quint64 pixels;
+        quint64 bulb_hits;
+        quint64 period_hits;
+        quint64 rebases; // 扰动计算中的重定基次数
+        quint64 skipped; // 级数近似跳过的迭代次数
+        quint64 bla_jumps; // BLA成段跳过的段数
+        quint64 bla_skipped; // BLA跳过的迭代次数
+        quint64 tile_hits; // 块缓存命中的块数
+        quint64 tile_misses;
+        quint64 filled; // 放大复用时按旧网格推断为集合内部、未经计算的点数
+
+        CalcStats() :
+            pixels(0), bulb_hits(0), period_hits(0), rebases(0), skipped(0), bla_jumps(0), bla_skipped(0),
+            tile_hits(0), tile_misses(0), filled(0) {}
+        void add(CalcStats const& o) {
+            pixels += o.pixels;
+            bulb_hits += o.bulb_hits;
+            period_hits += o.period_hits;
+            rebases += o.rebases;
+            skipped += o.skipped;
+            bla_jumps += o.bla_jumps;
+            bla_skipped += o.bla_skipped;
+            tile_hits += o.tile_hits;
+            tile_misses += o.tile_misses;
+            filled += o.filled;
+        }
+    };
+
+    /**
+     * @brief 点是否在主心形或周期2圆盘内, 这些点迭代必不逃逸
+     */
+    template<typename T>
+    inline bool inMainBulbs(T c_real, T c_imag) {
+        T y2 = c_imag * c_imag;
+        T x = c_real - (T)0.25;
+        T q = x * x + y2;
+        if(q * (q + x) <= y2 * (T)0.25) {
+            return true;
+        }
+        T x1 = c_real + 1;
+        return x1 * x1 + y2 <= (T)0.0625;
+    }
+
+    /**
+     * @brief 按选项计算一行: 先做解析判定, 余下的点压紧后交给calcRow
+     */
+    template<typename T>
+    void calcRow(const T* c_real, const T* c_imag, size_t* times, int n, size_t max_times,
+                 CalcOptions const& opt, CalcStats& stats) {
+        stats.pixels += n;
+        T period_eps = opt.periodicity ? (T)opt.period_eps : (T)0;
+        if(!opt.bulb_check) {
+            stats.period_hits += calcRow<T>(c_real, c_imag, times, n, max_times, period_eps);
+            return;
+        }
+        T cr[Tile::SIZE];
+        T ci[Tile::SIZE];
+        size_t t[Tile::SIZE];
+        int index[Tile::SIZE];
+        int m = 0;
+        for(int i = 0; i < n; i++) {
+            if(inMainBulbs<T>(c_real[i], c_imag[i])) {
+                times[i] = max_times;
+                stats.bulb_hits++;
+            } else {
+                cr[m] = c_real[i];
+                ci[m] = c_imag[i];
+                index[m++] = i;
+            }
+        }
+        stats.period_hits += calcRow<T>(cr, ci, t, m, max_times, period_eps);
+        for(int i = 0; i < m; i++) {
+            times[index[i]] = t[i];
+        }
+    }
+
+    /**
+     * @brief 按选项续算一行: 各点从z出发再迭代至多max_times次, times为本次的迭代次数, 结束时写回最终z.
+     * 心形/圆盘内与周期检测命中的点z实部写为INSIDE_MARK, 此后不必再续算
+     */
+    template<typename T>
+    void resumeRow(const T* c_real, const T* c_imag, T* z_real, T* z_imag, size_t* times, int n, size_t max_times,
+                   CalcOptions const& opt, CalcStats& stats) {
+        stats.pixels += n;
+        T period_eps = opt.periodicity ? (T)opt.period_eps : (T)0;
+        if(!opt.bulb_check) {
+            stats.period_hits += calcRow<T>(c_real, c_imag, times, n, max_times, period_eps, z_real, z_imag);
+            return;
+        }
+        T cr[CANCEL_CHUNK];
+        T ci[CANCEL_CHUNK];
+        T zr[CANCEL_CHUNK];
+        T zi[CANCEL_CHUNK];
+        size_t t[CANCEL_CHUNK];
+        int index[CANCEL_CHUNK];
+        int m = 0;
+        for(int i = 0; i < n; i++) {
+            if(inMainBulbs<T>(c_real[i], c_imag[i])) {
+                times[i] = max_times;
+                z_real[i] = (T)INSIDE_MARK;
+                stats.bulb_hits++;
+            } else {
+                cr[m] = c_real[i];
+                ci[m] = c_imag[i];
+                zr[m] = z_real[i];
+                zi[m] = z_imag[i];
+                index[m++] = i;
+            }
+        }
+        stats.period_hits += calcRow<T>(cr, ci, t, m, max_times, period_eps, zr, zi);
+        for(int i = 0; i < m; i++) {
+            times[index[i]] = t[i];
+            z_real[index[i]] = zr[i];
+            z_imag[index[i]] = zi[i];
+        }
+    }
+
+    /**
+     * @brief 计算核心, 与读取器配对使用: 读取器给出各点坐标, 核心据此算出迭代次数
+     */
     template<typename T>
-    void calc(Reader<T>& r) {
-        T x;
-        T y;
-        size_t times;
-        Writer* w;
-        while((w = r.get(x, y, times)) != NULL) {
-            times = calc<T>(x, y, times);
-            w->set(times);
-            delete w;
+    class Kernel {
+    public:
+        virtual ~Kernel() {}
+        // 计算开始前在管理线程中调用一次, 用于参考轨道等预计算
+        virtual void prepare(CancelToken const& token) {
+            Q_UNUSED(token)
+        }
+        virtual void calcRow(const T* c_real, const T* c_imag, size_t* times, int n, size_t max_times,
+                             CalcOptions const& opt, CalcStats& stats) = 0;
+        // 能否从保存的z续算, 为真时resumeRow可用, 一次至多CANCEL_CHUNK个点
+        virtual bool canResume() const {
+            return false;
+        }
+        virtual void resumeRow(const T* c_real, const T* c_imag, T* z_real, T* z_imag, size_t* times, int n,
+                               size_t max_times, CalcOptions const& opt, CalcStats& stats) {
+            Q_UNUSED(c_real)
+            Q_UNUSED(c_imag)
+            Q_UNUSED(z_real)
+            Q_UNUSED(z_imag)
+            Q_UNUSED(times)
+            Q_UNUSED(n)
+            Q_UNUSED(max_times)
+            Q_UNUSED(opt)
+            Q_UNUSED(stats)
+        }
+    };
+
+    /**
+     * @brief 直接逃逸迭代, 坐标为c本身
+     */
+    template<typename T>
+    class EscapeKernel : public Kernel<T> {
+    public:
+        virtual void calcRow(const T* c_real, const T* c_imag, size_t* times, int n, size_t max_times,
+                             CalcOptions const& opt, CalcStats& stats) {
+            Mandelbrot::calcRow<T>(c_real, c_imag, times, n, max_times, opt, stats);
+        }
+        virtual bool canResume() const {
+            return true;
+        }
+        virtual void resumeRow(const T* c_real, const T* c_imag, T* z_real, T* z_imag, size_t* times, int n,
+                               size_t max_times, CalcOptions const& opt, CalcStats& stats) {
+            Mandelbrot::resumeRow<T>(c_real, c_imag, z_real, z_imag, times, n, max_times, opt, stats);
+        }
+    };
+
+    template<typename T>
+    bool Reader<T>::calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                             CalcOptions const& opt, CalcStats& stats) {
+        T x[Tile::SIZE];
+        T y[Tile::SIZE];
+        size_t times[Tile::SIZE];
+        size_t max_times = getMaxTimes();
+        int n = tile.x1 - tile.x0;
+        for(int row = tile.y0; row < tile.y1; row++) {
+            getRow(tile, row, x, y);
+            // 分段计算, 深迭代时也能及时响应取消
+            for(int i = 0; i < n; i += CANCEL_CHUNK) {
+                if(token.isCancelled()) {
+                    return false;
+                }
+                kernel.calcRow(x + i, y + i, times + i, qMin((int)CANCEL_CHUNK, n - i), max_times, opt, stats);
+            }
+            setRow(tile, row, times);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 矩形细分(Mariani-Silver)读取器
+     * 块内先算矩形边框, 边框各点迭代次数全部相同时整块填充, 否则沿长边对分,
+     * 只算分割线再分别处理两半. 集合内部与大片同色区域只需迭代边框, 统计中的点数即实际迭代的点数
+     */
+    template<typename T>
+    class MarianiSilverImageReader : public RectangleImageReader<T> {
+    private:
+        enum { MIN_SIZE = 4 }; // 内部边长小于此值时不再细分, 直接逐点计算
+
+        // 闭区间, 边框均已算出
+        struct Rect {
+            int x0;
+            int y0;
+            int x1;
+            int y1;
+        };
+
+        /**
+         * @brief 待算点缓冲, 攒满CANCEL_CHUNK个点再交给核心, 短的分割线也能填满向量通道
+         */
+        struct Pending {
+            T c_real[CANCEL_CHUNK];
+            T c_imag[CANCEL_CHUNK];
+            size_t times[CANCEL_CHUNK];
+            int offset[CANCEL_CHUNK];
+            int n;
+        };
+
+        bool flush(Pending& p, Kernel<T>& kernel, CancelToken const& token, CalcOptions const& opt,
+                   CalcStats& stats) {
+            if(p.n == 0) {
+                return true;
+            }
+            if(token.isCancelled()) {
+                return false;
+            }
+            kernel.calcRow(p.c_real, p.c_imag, p.times, p.n, this->max_times, opt, stats);
+            for(int k = 0; k < p.n; k++) {
+                this->data[p.offset[k]] = (quint32)p.times[k];
+            }
+            p.n = 0;
+            return true;
+        }
+
+        // 将由(x, y)起沿(dx, dy)方向的n个点加入缓冲
+        bool addLine(Pending& p, int x, int y, int dx, int dy, int n, Kernel<T>& kernel,
+                     CancelToken const& token, CalcOptions const& opt, CalcStats& stats) {
+            for(int i = 0; i < n; i++, x += dx, y += dy) {
+                this->getPoint(x, y, p.c_real[p.n], p.c_imag[p.n]);
+                p.offset[p.n] = y * this->pwidth + x;
+                if(++p.n == CANCEL_CHUNK && !flush(p, kernel, token, opt, stats)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool sameBorder(Rect const& r, quint32& value) const {
+            const quint32* data = this->data;
+            const int w = this->pwidth;
+            value = data[r.y0 * w + r.x0];
+            for(int x = r.x0; x <= r.x1; x++) {
+                if(data[r.y0 * w + x] != value || data[r.y1 * w + x] != value) return false;
+            }
+            for(int y = r.y0 + 1; y < r.y1; y++) {
+                if(data[y * w + r.x0] != value || data[y * w + r.x1] != value) return false;
+            }
+            return true;
+        }
+
+    public:
+        MarianiSilverImageReader(TimesBuffer* buf, T lux, T luy, T width, T height) :
+            RectangleImageReader<T>(buf, lux, luy, width, height) {
+        }
+
+        virtual bool calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                              CalcOptions const& opt, CalcStats& stats) {
+            Rect whole = {tile.x0, tile.y0, tile.x1 - 1, tile.y1 - 1};
+            const int w = tile.x1 - tile.x0;
+            const int h = tile.y1 - tile.y0;
+            Pending p;
+            p.n = 0;
+            if(!addLine(p, whole.x0, whole.y0, 1, 0, w, kernel, token, opt, stats)) return false;
+            if(h > 1 && !addLine(p, whole.x0, whole.y1, 1, 0, w, kernel, token, opt, stats)) return false;
+            if(h > 2) {
+                if(!addLine(p, whole.x0, whole.y0 + 1, 0, 1, h - 2, kernel, token, opt, stats)) return false;
+                if(w > 1 && !addLine(p, whole.x1, whole.y0 + 1, 0, 1, h - 2, kernel, token, opt, stats)) return false;
+            }
+            if(!flush(p, kernel, token, opt, stats)) return false;
+            // 逐层处理: 同一层各矩形的分割线一并计算, 算完后再检查下一层的边框
+            QVector<Rect> level, next;
+            level.append(whole);
+            while(!level.isEmpty()) {
+                next.clear();
+                for(int i = 0; i < level.size(); i++) {
+                    Rect const& r = level[i];
+                    const int iw = r.x1 - r.x0 - 1;
+                    const int ih = r.y1 - r.y0 - 1;
+                    if(iw <= 0 || ih <= 0) {
+                        continue;
+                    }
+                    quint32 value;
+                    if(sameBorder(r, value)) {
+                        for(int y = r.y0 + 1; y < r.y1; y++) {
+                            quint32* row_data = this->data + y * this->pwidth;
+                            for(int x = r.x0 + 1; x < r.x1; x++) {
+                                row_data[x] = value;
+                            }
+                        }
+                        continue;
+                    }
+                    if(iw < MIN_SIZE || ih < MIN_SIZE) {
+                        for(int y = r.y0 + 1; y < r.y1; y++) {
+                            if(!addLine(p, r.x0 + 1, y, 1, 0, iw, kernel, token, opt, stats)) return false;
+                        }
+                        continue;
+                    }
+                    if(iw >= ih) {
+                        int xm = (r.x0 + r.x1) / 2;
+                        if(!addLine(p, xm, r.y0 + 1, 0, 1, ih, kernel, token, opt, stats)) return false;
+                        Rect a = {r.x0, r.y0, xm, r.y1};
+                        Rect b = {xm, r.y0, r.x1, r.y1};
+                        next.append(a);
+                        next.append(b);
+                    } else {
+                        int ym = (r.y0 + r.y1) / 2;
+                        if(!addLine(p, r.x0 + 1, ym, 1, 0, iw, kernel, token, opt, stats)) return false;
+                        Rect a = {r.x0, r.y0, r.x1, ym};
+                        Rect b = {r.x0, ym, r.x1, r.y1};
+                        next.append(a);
+                        next.append(b);
+                    }
+                }
+                if(!flush(p, kernel, token, opt, stats)) return false;
+                level.swap(next);
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @brief 边界追踪读取器
+     * 块内先算边框, 此后相邻(含对角)两点迭代次数不同时, 两点周围尚未计算的点全部加入队列,
+     * 计算沿各等迭代次数区域的轮廓推进; 队列清空后未算的点与轮廓围成的区域内部同值, 按行取左邻点填充.
+     * 各块边框均逐点算出, 块间接缝与逐点计算一致, 块照常由各计算线程并行处理;
+     * 块内部被同一迭代次数整圈包住、追踪始终没有到达的等值孤岛会被外围的值填掉, 不限于单点, 大小也不限,
+     * 因此结果是近似的, 不保证与逐点计算相同, 界面中标为近似
+     */
+    template<typename T>
+    class BoundaryTraceImageReader : public RectangleImageReader<T> {
+    private:
+        enum { UNKNOWN, QUEUED, DONE, OUTSIDE };
+        // 块四周各留一圈OUTSIDE, 查相邻点时不必判断越界
+        enum { STRIDE = Tile::SIZE + 2 };
+
+        /**
+         * @brief 块内的追踪状态, 下标为(y + 1) * STRIDE + x + 1
+         */
+        struct Trace {
+            quint8 state[STRIDE * STRIDE];
+            quint32 value[STRIDE * STRIDE];
+            int queue[Tile::SIZE * Tile::SIZE];
+            int head;
+            int tail;
+        };
+
+        static void enqueue(Trace& t, int p) {
+            if(t.state[p] != UNKNOWN) return;
+            t.state[p] = QUEUED;
+            t.queue[t.tail++] = p;
+        }
+
+        static void enqueueAround(Trace& t, int p) {
+            enqueue(t, p - STRIDE - 1);
+            enqueue(t, p - STRIDE);
+            enqueue(t, p - STRIDE + 1);
+            enqueue(t, p - 1);
+            enqueue(t, p + 1);
+            enqueue(t, p + STRIDE - 1);
+            enqueue(t, p + STRIDE);
+            enqueue(t, p + STRIDE + 1);
+        }
+
+    public:
+        BoundaryTraceImageReader(TimesBuffer* buf, T lux, T luy, T width, T height) :
+            RectangleImageReader<T>(buf, lux, luy, width, height) {
+        }
+
+        virtual bool calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                              CalcOptions const& opt, CalcStats& stats) {
+            const int w = tile.x1 - tile.x0;
+            const int h = tile.y1 - tile.y0;
+            Trace t;
+            t.head = t.tail = 0;
+            memset(t.state, OUTSIDE, sizeof(t.state));
+            for(int y = 1; y <= h; y++) {
+                memset(t.state + y * STRIDE + 1, UNKNOWN, w);
+            }
+            // 各列的实部与各行的虚部
+            T col_real[Tile::SIZE];
+            T row_imag[Tile::SIZE];
+            T unused;
+            for(int x = 0; x < w; x++) {
+                this->getPoint(tile.x0 + x, tile.y0, col_real[x], unused);
+            }
+            for(int y = 0; y < h; y++) {
+                this->getPoint(tile.x0, tile.y0 + y, unused, row_imag[y]);
+            }
+            for(int x = 1; x <= w; x++) {
+                enqueue(t, STRIDE + x);
+                enqueue(t, h * STRIDE + x);
+            }
+            for(int y = 2; y < h; y++) {
+                enqueue(t, y * STRIDE + 1);
+                enqueue(t, y * STRIDE + w);
+            }
+            T c_real[CANCEL_CHUNK];
+            T c_imag[CANCEL_CHUNK];
+            size_t times[CANCEL_CHUNK];
+            const int around[8] = {-STRIDE - 1, -STRIDE, -STRIDE + 1, -1, 1, STRIDE - 1, STRIDE, STRIDE + 1};
+            // 队列中的点每次取CANCEL_CHUNK个一并计算, 算完再与已算出的相邻点比较
+            while(t.head < t.tail) {
+                if(token.isCancelled()) {
+                    return false;
+                }
+                const int* batch = t.queue + t.head;
+                const int n = qMin((int)CANCEL_CHUNK, t.tail - t.head);
+                t.head += n;
+                for(int i = 0; i < n; i++) {
+                    c_real[i] = col_real[batch[i] % STRIDE - 1];
+                    c_imag[i] = row_imag[batch[i] / STRIDE - 1];
+                }
+                kernel.calcRow(c_real, c_imag, times, n, this->max_times, opt, stats);
+                for(int i = 0; i < n; i++) {
+                    t.value[batch[i]] = (quint32)times[i];
+                    t.state[batch[i]] = DONE;
+                }
+                for(int i = 0; i < n; i++) {
+                    const int p = batch[i];
+                    const quint32 value = t.value[p];
+                    bool edge = false;
+                    for(int k = 0; k < 8; k++) {
+                        const int q = p + around[k];
+                        if(t.state[q] == DONE && t.value[q] != value) {
+                            enqueueAround(t, q);
+                            edge = true;
+                        }
+                    }
+                    if(edge) {
+                        enqueueAround(t, p);
+                    }
+                }
+            }
+            // 边框均已算出, 每行未算的点左侧总有已算或已填的点
+            for(int y = 1; y <= h; y++) {
+                const int row = y * STRIDE;
+                quint32* row_data = this->data + (tile.y0 + y - 1) * this->pwidth + tile.x0 - 1;
+                for(int x = 1; x <= w; x++) {
+                    if(t.state[row + x] == UNKNOWN) {
+                        t.value[row + x] = t.value[row + x - 1];
+                    }
+                    row_data[x] = t.value[row + x];
+                }
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @brief 按核心的数值类型读写续算状态, orbit为NULL时不记录. 各线程只写各自块内的点
+     */
+    template<typename T>
+    struct OrbitView {
+        T* const z;
+        quint8* const state;
+
+        explicit OrbitView(OrbitBuffer* orbit) :
+            z(orbit ? orbit->zData<T>() : NULL), state(orbit ? orbit->stateBits() : NULL) {
+        }
+        // 保存达到迭代上限的点的最终z
+        void save(int index, T const& z_real, T const& z_imag) {
+            state[index] = (T)2 < z_real ? OrbitBuffer::ORBIT_INSIDE : OrbitBuffer::ORBIT_RESUMABLE;
+            z[2 * index] = z_real;
+            z[2 * index + 1] = z_imag;
+        }
+    };
+
+    /**
+     * @brief 包装另一读取器并接管其所有权, 默认全部转交给它, 子类只改写需要的部分
+     */
+    template<typename T>
+    class ReaderWrapper : public Reader<T> {
+    protected:
+        Reader<T>* const base;
+    public:
+        explicit ReaderWrapper(Reader<T>* base) : base(base) {}
+        virtual ~ReaderWrapper() {
+            delete base;
+        }
+        virtual size_t getMaxTimes() {
+            return base->getMaxTimes();
+        }
+        virtual int getTileCount() {
+            return base->getTileCount();
+        }
+        virtual void getTile(int index, Tile& tile) {
+            base->getTile(index, tile);
+        }
+        virtual void getPoint(int x, int y, T& c_real, T& c_imag) {
+            base->getPoint(x, y, c_real, c_imag);
+        }
+        virtual void getRow(Tile const& tile, int y, T* c_real, T* c_imag) {
+            base->getRow(tile, y, c_real, c_imag);
+        }
+        virtual void setRow(Tile const& tile, int y, const size_t* times) {
+            base->setRow(tile, y, times);
+        }
+        virtual bool calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                              CalcOptions const& opt, CalcStats& stats) {
+            return base->calcTile(tile, kernel, token, opt, stats);
+        }
+        virtual int getStageCount() {
+            return base->getStageCount();
+        }
+        virtual void setStage(int stage) {
+            base->setStage(stage);
+        }
+        virtual void finishStage() {
+            base->finishStage();
+        }
+    };
+
+    /**
+     * @brief 由粗到细分遍计算的读取器, 包装另一读取器并接管其所有权
+     * 第s遍只算步长为2^(STAGES - 1 - s)的网格上新增的采样点, 已算的点直接保留,
+     * 每个采样点同时填满以它为左上角的步长见方小块, 首遍只算1/16的点即可显示完整的粗略图.
+     * 末遍若底层读取器另有填充策略, 则整块交给它计算
+     */
+    template<typename T>
+    class ProgressiveImageReader : public ReaderWrapper<T> {
+    private:
+        enum { STAGES = 3 };
+
+        quint32* const data;
+        const int pwidth;
+        const bool reuse;
+        OrbitView<T> orbit;
+        int stage;
+
+        struct Pending {
+            T c_real[CANCEL_CHUNK];
+            T c_imag[CANCEL_CHUNK];
+            size_t times[CANCEL_CHUNK];
+            int x[CANCEL_CHUNK];
+            int y[CANCEL_CHUNK];
+            int n;
+        };
+
+        bool flush(Pending& p, Tile const& tile, int step, Kernel<T>& kernel, CancelToken const& token,
+                   CalcOptions const& opt, CalcStats& stats) {
+            if(p.n == 0) {
+                return true;
+            }
+            if(token.isCancelled()) {
+                return false;
+            }
+            const size_t max_times = this->base->getMaxTimes();
+            if(orbit.z && kernel.canResume()) {
+                // 从z = 0续算即普通计算, 顺带得到最终z
+                T z_real[CANCEL_CHUNK];
+                T z_imag[CANCEL_CHUNK];
+                for(int i = 0; i < p.n; i++) {
+                    z_real[i] = 0;
+                    z_imag[i] = 0;
+                }
+                kernel.resumeRow(p.c_real, p.c_imag, z_real, z_imag, p.times, p.n, max_times, opt, stats);
+                for(int i = 0; i < p.n; i++) {
+                    if(p.times[i] == max_times) {
+                        orbit.save(p.y[i] * pwidth + p.x[i], z_real[i], z_imag[i]);
+                    }
+                }
+            } else {
+                kernel.calcRow(p.c_real, p.c_imag, p.times, p.n, max_times, opt, stats);
+            }
+            for(int i = 0; i < p.n; i++) {
+                const int x1 = qMin(p.x[i] + step, tile.x1);
+                const int y1 = qMin(p.y[i] + step, tile.y1);
+                for(int y = p.y[i]; y < y1; y++) {
+                    quint32* row_data = data + y * pwidth;
+                    for(int x = p.x[i]; x < x1; x++) {
+                        row_data[x] = (quint32)p.times[i];
+                    }
+                }
+            }
+            p.n = 0;
+            return true;
+        }
+
+    public:
+        // reuse为真时末遍也只算新增的点, 底层为逐点计算时使用, 此时各点均由本读取器算出, 可记录续算状态
+        ProgressiveImageReader(Reader<T>* base, TimesBuffer* buf, bool reuse, OrbitBuffer* orbit) :
+            ReaderWrapper<T>(base), data(buf->bits()), pwidth(buf->width()), reuse(reuse),
+            orbit(reuse ? orbit : NULL), stage(0) {
+        }
+        virtual int getStageCount() {
+            return STAGES;
+        }
+        virtual void setStage(int stage) {
+            this->stage = stage;
+        }
+
+        virtual bool calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                              CalcOptions const& opt, CalcStats& stats) {
+            const int step = 1 << (STAGES - 1 - stage);
+            if(step == 1 && !reuse) {
+                return this->base->calcTile(tile, kernel, token, opt, stats);
+            }
+            // 块的起点为Tile::SIZE的倍数, 各遍网格在块间对齐
+            Pending p;
+            p.n = 0;
+            for(int y = tile.y0; y < tile.y1; y += step) {
+                const bool old_row = stage > 0 && y % (2 * step) == 0;
+                for(int x = tile.x0; x < tile.x1; x += step) {
+                    if(old_row && x % (2 * step) == 0) {
+                        continue; // 上一遍已算
+                    }
+                    this->base->getPoint(x, y, p.c_real[p.n], p.c_imag[p.n]);
+                    p.x[p.n] = x;
+                    p.y[p.n] = y;
+                    if(++p.n == CANCEL_CHUNK && !flush(p, tile, step, kernel, token, opt, stats)) {
+                        return false;
+                    }
+                }
+            }
+            return flush(p, tile, step, kernel, token, opt, stats);
+        }
+    };
+
+    /**
+     * @brief 提高迭代上限后的续算读取器, 包装另一读取器并接管其所有权
+     * 缓冲中已是旧上限from下的结果, 已逃逸的点不受上限影响, 只有迭代次数等于from的点需要再算:
+     * 保存了z的点接着迭代max_times - from次, 已判定在集合内的点直接记为max_times, 其余从z = 0重算.
+     * 周期检测的记录点与检测间隔不保存, 续算从z处重新开始检测, 命中周期的点及其迭代次数可能与一次算到
+     * max_times不同; 关闭周期检测时结果与直接计算一致
+     */
+    template<typename T>
+    class ResumeImageReader : public ReaderWrapper<T> {
+    private:
+        quint32* const data;
+        const int pwidth;
+        const size_t from;
+        OrbitView<T> orbit;
+
+        struct Pending {
+            T c_real[CANCEL_CHUNK];
+            T c_imag[CANCEL_CHUNK];
+            T z_real[CANCEL_CHUNK];
+            T z_imag[CANCEL_CHUNK];
+            size_t times[CANCEL_CHUNK];
+            int index[CANCEL_CHUNK];
+            int n;
+        };
+
+        // start为各点已迭代的次数
+        bool flush(Pending& p, size_t start, Kernel<T>& kernel, CancelToken const& token,
+                   CalcOptions const& opt, CalcStats& stats) {
+            if(p.n == 0) {
+                return true;
+            }
+            if(token.isCancelled()) {
+                return false;
+            }
+            const size_t max_times = this->base->getMaxTimes();
+            if(!kernel.canResume()) {
+                kernel.calcRow(p.c_real, p.c_imag, p.times, p.n, max_times, opt, stats);
+            } else {
+                kernel.resumeRow(p.c_real, p.c_imag, p.z_real, p.z_imag, p.times, p.n, max_times - start,
+                                 opt, stats);
+            }
+            for(int i = 0; i < p.n; i++) {
+                const size_t times = start + p.times[i];
+                data[p.index[i]] = (quint32)times;
+                if(orbit.z && kernel.canResume() && times == max_times) {
+                    orbit.save(p.index[i], p.z_real[i], p.z_imag[i]);
+                }
+            }
+            p.n = 0;
+            return true;
+        }
+
+    public:
+        ResumeImageReader(Reader<T>* base, TimesBuffer* buf, OrbitBuffer* orbit, size_t from) :
+            ReaderWrapper<T>(base), data(buf->bits()), pwidth(buf->width()), from(from), orbit(orbit) {
+        }
+
+        virtual bool calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                              CalcOptions const& opt, CalcStats& stats) {
+            const size_t max_times = this->base->getMaxTimes();
+            const bool resume = orbit.z && kernel.canResume();
+            Pending resumed;
+            Pending restarted;
+            resumed.n = 0;
+            restarted.n = 0;
+            for(int y = tile.y0; y < tile.y1; y++) {
+                for(int x = tile.x0; x < tile.x1; x++) {
+                    const int index = y * pwidth + x;
+                    if(data[index] != from) {
+                        continue;
+                    }
+                    Pending* p = &restarted;
+                    if(resume && orbit.state[index] == OrbitBuffer::ORBIT_INSIDE) {
+                        data[index] = (quint32)max_times;
+                        continue;
+                    }
+                    if(resume && orbit.state[index] == OrbitBuffer::ORBIT_RESUMABLE) {
+                        p = &resumed;
+                        p->z_real[p->n] = orbit.z[2 * index];
+                        p->z_imag[p->n] = orbit.z[2 * index + 1];
+                    } else {
+                        p->z_real[p->n] = 0;
+                        p->z_imag[p->n] = 0;
+                    }
+                    this->base->getPoint(x, y, p->c_real[p->n], p->c_imag[p->n]);
+                    p->index[p->n] = index;
+                    if(++p->n == CANCEL_CHUNK
+                            && !flush(*p, p == &resumed ? from : 0, kernel, token, opt, stats)) {
+                        return false;
+                    }
+                }
+            }
+            return flush(resumed, from, kernel, token, opt, stats) && flush(restarted, 0, kernel, token, opt, stats);
+        }
+    };
+
+    /**
+     * @brief 向负无穷取整的整数除法, b > 0
+     */
+    inline int floorDiv(int a, int b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    /**
+     * @brief 整数倍放大复用的读取器, 包装按填充方式建立的读取器并接管其所有权
+     * 放大前的图(X, Y)与新图(scale * X + dx, scale * Y + dy)坐标相同.
+     * 分遍时首遍不调用核心, 各点取所在旧网格单元左上角的旧值, 即得完整的粗略图.
+     * 末遍逐点计算时重合的点直接取旧值, 其余点所在的旧网格单元连同外围一圈(4 x 4个旧点)全部达到迭代上限时
+     * 视为集合内部直接填充(计入CalcStats::filled, 续算状态记为ORBIT_FILLED), 否则逐点计算;
+     * 旧图中推断填入的点不算数: 重合时重新计算, 也不参与内部判定, 误差不会随连续放大累积.
+     * 不记录续算状态时无从标记, 不填充. 矩形细分与边界追踪时末遍整块交给底层读取器, 旧图只用于首遍.
+     * 旧图须与新图迭代上限相同
+     */
+    template<typename T>
+    class ZoomImageReader : public ReaderWrapper<T> {
+    private:
+        quint32* const data;
+        const int pwidth;
+        const QVector<quint32> parent; // 复制一份, 不依赖调用方保留旧缓冲
+        const QVector<quint8> parent_state; // 旧图的续算状态, 空时视为各点均为算得
+        const int parent_width;
+        const int parent_height;
+        const int scale;
+        const int dx;
+        const int dy;
+        const int stages;
+        const bool reuse;
+        OrbitView<T> orbit;
+        int stage;
+
+        struct Pending {
+            T c_real[CANCEL_CHUNK];
+            T c_imag[CANCEL_CHUNK];
+            size_t times[CANCEL_CHUNK];
+            int index[CANCEL_CHUNK];
+            int n;
+        };
+
+        static QVector<quint32> copyTimes(TimesBuffer const& buf) {
+            QVector<quint32> v(buf.width() * buf.height());
+            for(int y = 0; y < buf.height(); y++) {
+                memcpy(v.data() + y * buf.width(), buf.constScanLine(y), buf.width() * sizeof(quint32));
+            }
+            return v;
+        }
+
+        static QVector<quint8> copyState(OrbitBuffer const* orbit) {
+            QVector<quint8> v;
+            if(orbit) {
+                const int n = orbit->width() * orbit->height();
+                v.resize(n);
+                memcpy(v.data(), orbit->constStateBits(), n);
+            }
+            return v;
+        }
+
+        // 旧点是否推断填入
+        bool filled(int index) const {
+            return !parent_state.isEmpty() && parent_state[index] == OrbitBuffer::ORBIT_FILLED;
+        }
+
+        // 以(px0, py0)为左上角的旧网格单元连同外围一圈是否全部算得且达到迭代上限
+        bool interior(int px0, int py0, size_t max_times) const {
+            if(px0 < 1 || py0 < 1 || px0 + 3 > parent_width || py0 + 3 > parent_height) {
+                return false;
+            }
+            for(int py = py0 - 1; py < py0 + 3; py++) {
+                const quint32* row = parent.constData() + py * parent_width;
+                for(int px = px0 - 1; px < px0 + 3; px++) {
+                    if(row[px] != max_times || filled(py * parent_width + px)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool flush(Pending& p, Kernel<T>& kernel, CancelToken const& token, CalcOptions const& opt, CalcStats& stats) {
+            if(p.n == 0) {
+                return true;
+            }
+            if(token.isCancelled()) {
+                return false;
+            }
+            const size_t max_times = this->base->getMaxTimes();
+            if(orbit.z && kernel.canResume()) {
+                T z_real[CANCEL_CHUNK];
+                T z_imag[CANCEL_CHUNK];
+                for(int i = 0; i < p.n; i++) {
+                    z_real[i] = 0;
+                    z_imag[i] = 0;
+                }
+                kernel.resumeRow(p.c_real, p.c_imag, z_real, z_imag, p.times, p.n, max_times, opt, stats);
+                for(int i = 0; i < p.n; i++) {
+                    if(p.times[i] == max_times) {
+                        orbit.save(p.index[i], z_real[i], z_imag[i]);
+                    }
+                }
+            } else {
+                kernel.calcRow(p.c_real, p.c_imag, p.times, p.n, max_times, opt, stats);
+            }
+            for(int i = 0; i < p.n; i++) {
+                data[p.index[i]] = (quint32)p.times[i];
+            }
+            p.n = 0;
+            return true;
+        }
+
+        // 首遍: 各点取所在旧网格单元左上角的旧值, 超出旧图的取边上的点
+        void seed(Tile const& tile) {
+            for(int y = tile.y0; y < tile.y1; y++) {
+                const int py = qBound(0, floorDiv(y - dy, scale), parent_height - 1);
+                const quint32* parent_row = parent.constData() + py * parent_width;
+                quint32* row = data + y * pwidth;
+                for(int x = tile.x0; x < tile.x1; x++) {
+                    row[x] = parent_row[qBound(0, floorDiv(x - dx, scale), parent_width - 1)];
+                }
+            }
+        }
+
+    public:
+        // progressive为真时先以旧图作首遍; reuse为真时末遍由本读取器逐点计算, 底层为逐点计算时使用.
+        // parent_orbit为旧图的续算状态, 用于识别推断填入的点. 复用的点不记录z, 续算时从z = 0重算
+        ZoomImageReader(Reader<T>* base, TimesBuffer* buf, TimesBuffer const& parent_buf,
+                        OrbitBuffer const* parent_orbit, int scale, int dx, int dy,
+                        bool progressive, bool reuse, OrbitBuffer* orbit) :
+            ReaderWrapper<T>(base), data(buf->bits()), pwidth(buf->width()), parent(copyTimes(parent_buf)),
+            parent_state(copyState(parent_orbit)),
+            parent_width(parent_buf.width()), parent_height(parent_buf.height()), scale(scale), dx(dx), dy(dy),
+            stages(progressive ? 2 : 1), reuse(reuse), orbit(reuse ? orbit : NULL), stage(0) {
+        }
+        virtual int getStageCount() {
+            return stages;
+        }
+        virtual void setStage(int stage) {
+            this->stage = stage;
+        }
+
+        virtual bool calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                              CalcOptions const& opt, CalcStats& stats) {
+            if(stage + 1 < stages) {
+                seed(tile);
+                return !token.isCancelled();
+            }
+            if(!reuse) {
+                return this->base->calcTile(tile, kernel, token, opt, stats);
+            }
+            const size_t max_times = this->base->getMaxTimes();
+            // 各列所在的旧网格列, 不在旧网格上的列记为-1
+            int cell_x[Tile::SIZE];
+            int parent_x[Tile::SIZE];
+            for(int x = tile.x0; x < tile.x1; x++) {
+                const int px = floorDiv(x - dx, scale);
+                cell_x[x - tile.x0] = px;
+                parent_x[x - tile.x0] = px * scale + dx == x && px >= 0 && px < parent_width ? px : -1;
+            }
+            T c_real[Tile::SIZE];
+            T c_imag[Tile::SIZE];
+            Pending p;
+            p.n = 0;
+            for(int y = tile.y0; y < tile.y1; y++) {
+                const int py = floorDiv(y - dy, scale);
+                const bool on_row = py * scale + dy == y && py >= 0 && py < parent_height;
+                this->base->getRow(tile, y, c_real, c_imag);
+                int last_cell = -2;
+                bool inside = false;
+                for(int i = 0; i < tile.x1 - tile.x0; i++) {
+                    const int index = y * pwidth + tile.x0 + i;
+                    if(on_row && parent_x[i] >= 0 && !filled(py * parent_width + parent_x[i])) {
+                        data[index] = parent[py * parent_width + parent_x[i]];
+                        continue;
+                    }
+                    if(cell_x[i] != last_cell) {
+                        last_cell = cell_x[i];
+                        inside = orbit.state && interior(last_cell, py, max_times);
+                    }
+                    if(inside) {
+                        data[index] = (quint32)max_times;
+                        orbit.state[index] = OrbitBuffer::ORBIT_FILLED;
+                        stats.filled++;
+                        continue;
+                    }
+                    p.c_real[p.n] = c_real[i];
+                    p.c_imag[p.n] = c_imag[i];
+                    p.index[p.n] = index;
+                    if(++p.n == CANCEL_CHUNK && !flush(p, kernel, token, opt, stats)) {
+                        return false;
+                    }
+                }
+            }
+            return flush(p, kernel, token, opt, stats);
+        }
+    };
+
+    /**
+     * @brief 只计算给定矩形的读取器, 其余点保留缓冲中的原值
+     * 底层的块按矩形裁剪后作为新的块, 填充策略照常作用于裁剪后的块
+     */
+    template<typename T>
+    class RegionImageReader : public ReaderWrapper<T> {
+    private:
+        QVector<Tile> tiles;
+    public:
+        RegionImageReader(Reader<T>* base, QVector<Tile> const& regions) : ReaderWrapper<T>(base) {
+            Tile t;
+            for(int i = 0; i < base->getTileCount(); i++) {
+                base->getTile(i, t);
+                for(int j = 0; j < regions.size(); j++) {
+                    Tile c;
+                    c.x0 = qMax(t.x0, regions[j].x0);
+                    c.y0 = qMax(t.y0, regions[j].y0);
+                    c.x1 = qMin(t.x1, regions[j].x1);
+                    c.y1 = qMin(t.y1, regions[j].y1);
+                    if(c.x0 < c.x1 && c.y0 < c.y1) {
+                        tiles.append(c);
+                    }
+                }
+            }
+        }
+        virtual int getTileCount() {
+            return tiles.size();
+        }
+        virtual void getTile(int index, Tile& tile) {
+            tile = tiles[index];
+        }
+    };
+
+    /**
+     * @brief 查询块缓存的读取器, 包装另一读取器并接管其所有权
+     * 首遍计算前先按键查缓存, 命中的块直接写入缓冲, 其后各遍跳过; 未命中的块在末遍算完后存入内存缓存,
+     * persist时另记下, 待末遍结束后由管理线程写入磁盘, 计算线程不等待磁盘. 含推断填充点的块不是算得的结果, 不存.
+     * 键由keyer按块在复平面上的位置生成, 不同视图中的同一块可以命中
+     */
+    template<typename T>
+    class CachedImageReader : public ReaderWrapper<T> {
+    private:
+        quint32* const data;
+        const int pwidth;
+        TileCache& cache;
+        TileKeyer* const keyer;
+        const bool persist;
+        quint8* const orbit_state;
+        int stage;
+        QMutex hits_mutex;
+        QSet<QString> hits;
+        QVector<Tile> unsaved; // 末遍算出、尚未写入磁盘的块
+
+    public:
+        // 接管keyer的所有权; persist为false时只存入内存缓存.
+        // 缓存只有迭代次数, 命中的块在orbit中记为ORBIT_NONE, 以免续算沿用此前保存的z
+        CachedImageReader(Reader<T>* base, TimesBuffer* buf, TileCache& cache, TileKeyer* keyer, bool persist,
+                          OrbitBuffer* orbit) :
+            ReaderWrapper<T>(base), data(buf->bits()), pwidth(buf->width()), cache(cache), keyer(keyer),
+            persist(persist), orbit_state(orbit ? orbit->stateBits() : NULL), stage(0), hits_mutex(), hits(),
+            unsaved() {
+        }
+        virtual ~CachedImageReader() {
+            delete keyer;
+        }
+        virtual void setStage(int stage) {
+            this->stage = stage;
+            this->base->setStage(stage);
+        }
+
+        virtual bool calcTile(Tile const& tile, Kernel<T>& kernel, CancelToken const& token,
+                              CalcOptions const& opt, CalcStats& stats) {
+            const int w = tile.x1 - tile.x0;
+            const int h = tile.y1 - tile.y0;
+            const QString key = keyer->key(tile.x0, tile.y0, w, h);
+            quint32* origin = data + tile.y0 * pwidth + tile.x0;
+            if(stage == 0) {
+                if(cache.find(key, origin, pwidth, w, h)) {
+                    if(orbit_state) {
+                        for(int y = tile.y0; y < tile.y1; y++) {
+                            memset(orbit_state + y * pwidth + tile.x0, OrbitBuffer::ORBIT_NONE, w);
+                        }
+                    }
+                    stats.tile_hits++;
+                    QMutexLocker locker(&hits_mutex);
+                    hits.insert(key);
+                    return true;
+                }
+                stats.tile_misses++;
+            } else {
+                QMutexLocker locker(&hits_mutex);
+                if(hits.contains(key)) {
+                    return true;
+                }
+            }
+            const quint64 filled = stats.filled;
+            if(!this->base->calcTile(tile, kernel, token, opt, stats)) {
+                return false;
+            }
+            if(stage + 1 == this->base->getStageCount() && stats.filled == filled) {
+                cache.insert(key, origin, pwidth, w, h);
+                if(persist) {
+                    QMutexLocker locker(&hits_mutex);
+                    unsaved.append(tile);
+                }
+            }
+            return true;
+        }
+        virtual void finishStage() {
+            this->base->finishStage();
+            // 末遍之后缓冲不再被改写, 直接从中取出各块
+            for(int i = 0; i < unsaved.size(); i++) {
+                Tile const& tile = unsaved[i];
+                const int w = tile.x1 - tile.x0;
+                const int h = tile.y1 - tile.y0;
+                cache.persist(keyer->key(tile.x0, tile.y0, w, h), data + tile.y0 * pwidth + tile.x0, pwidth, w, h);
+            }
+            unsaved.clear();
+        }
+    };
+
+    /**
+     * @brief 区域填充方式
+     */
+    enum FillMode {
+        FILL_EVERY_PIXEL,
+        FILL_MARIANI_SILVER,
+        FILL_BOUNDARY_TRACE
+    };
+
+    /**
+     * @brief 读取器的设置
+     */
+    struct ReaderOptions {
+        FillMode fill;
+        bool progressive; // 由粗到细分遍计算
+        bool partial; // 只计算regions中的矩形, 此时不分遍
+        QVector<Tile> regions;
+        OrbitBuffer* orbit; // 非NULL时记录达到迭代上限的点的z, 分遍逐点计算与续算时有效
+        size_t resume_from; // 非0时缓冲中已是此迭代上限下的结果, 只续算达到该上限的点
+        TimesBuffer const* parent; // 非NULL时为放大前的图, 新图(zoom * X + zoom_dx, zoom * Y + zoom_dy)即其(X, Y);
+                                   // 此时progressive以旧图作首遍
+        OrbitBuffer const* parent_orbit; // 放大前的图的续算状态, 标出其中推断填入的点
+        int zoom;
+        int zoom_dx;
+        int zoom_dy;
+        TileCache* cache; // 非NULL时先查块缓存
+        TileKeyer* cache_keyer; // 与cache同时设置, 读取器接管其所有权
+        bool cache_persist; // 算出的块同时写入磁盘块缓存
+
+        ReaderOptions() :
+            fill(FILL_EVERY_PIXEL), progressive(false), partial(false), regions(), orbit(NULL), resume_from(0),
+            parent(NULL), parent_orbit(NULL), zoom(1), zoom_dx(0), zoom_dy(0), cache(NULL), cache_keyer(NULL), cache_persist(false) {}
+    };
+
+    /**
+     * @brief 按设置建立矩形区域的读取器
+     * 扰动计算以图像中心为原点, 传入lux = -width / 2, luy = height / 2, 坐标即相对参考点的偏移dc
+     */
+    template<typename T>
+    Reader<T>* createImageReader(ReaderOptions const& ro, TimesBuffer* buf, T lux, T luy, T width, T height) {
+        Reader<T>* r;
+        if(ro.fill == FILL_MARIANI_SILVER) {
+            r = new MarianiSilverImageReader<T>(buf, lux, luy, width, height);
+        } else if(ro.fill == FILL_BOUNDARY_TRACE) {
+            r = new BoundaryTraceImageReader<T>(buf, lux, luy, width, height);
+        } else {
+            r = new RectangleImageReader<T>(buf, lux, luy, width, height);
+        }
+        if(ro.resume_from > 0) {
+            r = new ResumeImageReader<T>(r, buf, ro.orbit, ro.resume_from);
+        } else if(ro.parent && (ro.progressive || ro.fill == FILL_EVERY_PIXEL)) {
+            r = new ZoomImageReader<T>(r, buf, *ro.parent, ro.parent_orbit, ro.zoom, ro.zoom_dx, ro.zoom_dy,
+                                       ro.progressive, ro.fill == FILL_EVERY_PIXEL, ro.orbit);
+        } else if(ro.partial) {
+            r = new RegionImageReader<T>(r, ro.regions);
+        } else if(ro.progressive) {
+            r = new ProgressiveImageReader<T>(r, buf, ro.fill == FILL_EVERY_PIXEL, ro.orbit);
+        }
+        if(ro.cache) {
+            r = new CachedImageReader<T>(r, buf, *ro.cache, ro.cache_keyer, ro.cache_persist,
+                                        ro.orbit);
+        }
+        return r;
+    }
+
+    /**
+     * @brief 低分辨率试算: 块内均匀取PROBE x PROBE个点, 按平均迭代次数乘以块面积估计代价
+     */
+    template<typename T>
+    size_t estimateCost(Reader<T>& r, Kernel<T>& kernel, Tile const& tile, size_t max_times,
+                        CalcOptions const& opt) {
+        enum { PROBE = 4 };
+        T c_real[PROBE * PROBE];
+        T c_imag[PROBE * PROBE];
+        size_t times[PROBE * PROBE];
+        for(int j = 0; j < PROBE; j++) {
+            int y = tile.y0 + (tile.y1 - tile.y0) * (2 * j + 1) / (2 * PROBE);
+            for(int i = 0; i < PROBE; i++) {
+                int x = tile.x0 + (tile.x1 - tile.x0) * (2 * i + 1) / (2 * PROBE);
+                r.getPoint(x, y, c_real[j * PROBE + i], c_imag[j * PROBE + i]);
+            }
+        }
+        CalcStats stats;
+        kernel.calcRow(c_real, c_imag, times, PROBE * PROBE, max_times, opt, stats);
+        size_t sum = 0;
+        for(int i = 0; i < PROBE * PROBE; i++) {
+            sum += times[i] + 1;
+        }
+        return sum * (tile.x1 - tile.x0) * (tile.y1 - tile.y0) / (PROBE * PROBE);
+    }
+
+    template<typename T>
+    void calc(Reader<T>& r, Kernel<T>& kernel, TileScheduler& sched, int worker, CancelToken const& token,
+              CalcOptions const& opt, CalcStats& stats) {
+        Tile tile;
+        int index;
+        while(!token.isCancelled() && sched.pop(worker, index)) {
+            r.getTile(index, tile);
+            if(!r.calcTile(tile, kernel, token, opt, stats)) {
+                return;
+            }
+            sched.finish(index);
         }
     }
 
     template<typename T>
     class Calculator : public QRunnable {
     private:
-        Reader<double>& r;
+        Reader<T>& r;
+        Kernel<T>& kernel;
+        TileScheduler& sched;
+        const int worker;
+        CancelToken const& token;
+        CalcOptions const& opt;
+        CalcStats& stats;
 
     public:
-        explicit Calculator(Reader<double>& reader) :
-            r(reader) {
+        Calculator(Reader<T>& reader, Kernel<T>& kernel, TileScheduler& sched, int worker, CancelToken const& token,
+                   CalcOptions const& opt, CalcStats& stats) :
+            r(reader), kernel(kernel), sched(sched), worker(worker), token(token), opt(opt), stats(stats) {
             if(!this->autoDelete()) {
                 qDebug("未设置autoDelete默认值为true");
                 this->setAutoDelete(true);
@@ -137,7 +1590,74 @@ namespace Mandelbrot {
         }
 
         virtual void run() {
-            calc(r);
+            // 先在本地累加, 避免各线程的统计落在同一缓存行上
+            CalcStats local;
+            calc(r, kernel, sched, worker, token, opt, local);
+            stats = local;
+        }
+    };
+
+    /**
+     * @brief 与数值类型无关的计算任务, 供非模板的计算管理线程使用
+     */
+    class CalcTask {
+    public:
+        virtual ~CalcTask() {}
+        virtual void prepare(CancelToken const& token) = 0;
+        virtual size_t getMaxTimes() = 0;
+        virtual int getTileCount() = 0;
+        virtual void getTile(int index, Tile& tile) = 0;
+        virtual size_t estimateCost(int index, size_t probe_times, CalcOptions const& opt) = 0;
+        virtual int getStageCount() = 0;
+        virtual void setStage(int stage) = 0;
+        virtual void finishStage() = 0;
+        virtual QRunnable* createCalculator(TileScheduler& sched, int worker, CancelToken const& token,
+                                            CalcOptions const& opt, CalcStats& stats) = 0;
+    };
+
+    /**
+     * @brief 由读取器与核心组成的计算任务, 接管二者的所有权
+     */
+    template<typename T>
+    class ReaderCalcTask : public CalcTask {
+    private:
+        Reader<T>* const r;
+        Kernel<T>* const kernel;
+    public:
+        ReaderCalcTask(Reader<T>* reader, Kernel<T>* kernel) : r(reader), kernel(kernel) {}
+        virtual ~ReaderCalcTask() {
+            delete r;
+            delete kernel;
+        }
+        virtual void prepare(CancelToken const& token) {
+            kernel->prepare(token);
+        }
+        virtual size_t getMaxTimes() {
+            return r->getMaxTimes();
+        }
+        virtual int getTileCount() {
+            return r->getTileCount();
+        }
+        virtual void getTile(int index, Tile& tile) {
+            r->getTile(index, tile);
+        }
+        virtual int getStageCount() {
+            return r->getStageCount();
+        }
+        virtual void setStage(int stage) {
+            r->setStage(stage);
+        }
+        virtual void finishStage() {
+            r->finishStage();
+        }
+        virtual size_t estimateCost(int index, size_t probe_times, CalcOptions const& opt) {
+            Tile tile;
+            r->getTile(index, tile);
+            return Mandelbrot::estimateCost(*r, *kernel, tile, probe_times, opt);
+        }
+        virtual QRunnable* createCalculator(TileScheduler& sched, int worker, CancelToken const& token,
+                                            CalcOptions const& opt, CalcStats& stats) {
+            return new Calculator<T>(*r, *kernel, sched, worker, token, opt, stats);
         }
     };
 }
@@ -0,0 +1,259 @@
+#include "perturbation.h"
+#include <cmath>
+
+namespace {
+    Mandelbrot::BigFixed negated(Mandelbrot::BigFixed b) {
+        b.negate();
+        return b;
+    }
+}
+
+namespace Mandelbrot {
+
+    bool ReferenceOrbit::compute(BigFixed const& c_real, BigFixed const& c_imag, size_t max_times,
+                                 CancelToken const& token) {
+        const int frac = c_real.fracLimbs();
+        BigFixed zr(frac), zi(frac);
+        BigFixed zr2(frac), zi2(frac), zri(frac), t(frac);
+        z_real.clear();
+        z_imag.clear();
+        z_real.append(0);
+        z_imag.append(0);
+        for(size_t times = 0; times < max_times; times++) {
+            if((times & 0xfff) == 0 && token.isCancelled()) {
+                return false;
+            }
+            BigFixed::mul(zr, zr, zr2);
+            BigFixed::mul(zi, zi, zi2);
+            BigFixed::mul(zr, zi, zri);
+            // zr = zr^2 - zi^2 + cr, zi = 2 zr zi + ci
+            BigFixed::sub(zr2, zi2, t);
+            BigFixed::add(t, c_real, zr);
+            BigFixed::add(zri, zri, t);
+            BigFixed::add(t, c_imag, zi);
+            double r = zr.toDouble();
+            double i = zi.toDouble();
+            z_real.append(r);
+            z_imag.append(i);
+            if(r * r + i * i > 4) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    template<typename R>
+    const double SeriesApproximation<R>::TOLERANCE = 1e-4;
+
+    template<typename R>
+    SeriesApproximation<R>::SeriesApproximation() :
+        skip(0), a_real(0), a_imag(0), b_real(0), b_imag(0), c_real(0), c_imag(0), radius(1) {
+    }
+
+    template<typename R>
+    void SeriesApproximation<R>::compute(ReferenceOrbit const& orbit, R half_width, R half_height,
+                                         R pixel_spacing, size_t limit) {
+        using std::sqrt;
+        enum { PROBES = 8 };
+        const R zero(0);
+        radius = sqrt(half_width * half_width + half_height * half_height);
+        skip = 0;
+        a_real = a_imag = b_real = b_imag = c_real = c_imag = zero;
+        if(!(radius > zero)) {
+            radius = 1;
+            return;
+        }
+        // 探测点的u = dc / r与逐次迭代的偏移dz
+        const double sx[PROBES] = {-1, 1, -1, 1, -1, 1, 0, 0};
+        const double sy[PROBES] = {-1, -1, 1, 1, 0, 0, -1, 1};
+        R ur[PROBES], ui[PROBES], dzr[PROBES], dzi[PROBES];
+        for(int k = 0; k < PROBES; k++) {
+            ur[k] = sx[k] * half_width / radius;
+            ui[k] = sy[k] * half_height / radius;
+            dzr[k] = dzi[k] = zero;
+        }
+        const R pixel_u = pixel_spacing / radius;
+        const double* ref_r = orbit.real();
+        const double* ref_i = orbit.imag();
+        // 须留在参考轨道以内, 参考点逃逸的那一次不可跳过
+        size_t n_max = qMin(limit, (size_t)qMax(orbit.size() - 2, 0));
+        R ar = zero, ai = zero, br = zero, bi = zero, cr = zero, ci = zero;
+        for(size_t n = 0; n < n_max; n++) {
+            // A' = 2ZA + r, B' = 2ZB + A^2, C' = 2ZC + 2AB
+            double zr2 = 2 * ref_r[n];
+            double zi2 = 2 * ref_i[n];
+            R nar = zr2 * ar - zi2 * ai + radius;
+            R nai = zr2 * ai + zi2 * ar;
+            R nbr = zr2 * br - zi2 * bi + ar * ar - ai * ai;
+            R nbi = zr2 * bi + zi2 * br + 2 * ar * ai;
+            R ncr = zr2 * cr - zi2 * ci + 2 * (ar * br - ai * bi);
+            R nci = zr2 * ci + zi2 * cr + 2 * (ar * bi + ai * br);
+            R limit_err = TOLERANCE * pixel_u * sqrt(nar * nar + nai * nai);
+            bool valid = true;
+            for(int k = 0; k < PROBES; k++) {
+                // 探测点逐次迭代 dz' = (2Z + dz)dz + dc
+                R tr = zr2 + dzr[k];
+                R ti = zi2 + dzi[k];
+                R ndzr = tr * dzr[k] - ti * dzi[k] + ur[k] * radius;
+                R ndzi = tr * dzi[k] + ti * dzr[k] + ui[k] * radius;
+                dzr[k] = ndzr;
+                dzi[k] = ndzi;
+                double zr = ref_r[n + 1] + toDouble(ndzr);
+                double zi = ref_i[n + 1] + toDouble(ndzi);
+                if(zr * zr + zi * zi > 4) {
+                    valid = false;
+                    break;
+                }
+                // 多项式在探测点的值
+                R pr = ncr * ur[k] - nci * ui[k] + nbr;
+                R pi = ncr * ui[k] + nci * ur[k] + nbi;
+                R qr = pr * ur[k] - pi * ui[k] + nar;
+                R qi = pr * ui[k] + pi * ur[k] + nai;
+                R er = qr * ur[k] - qi * ui[k] - ndzr;
+                R ei = qr * ui[k] + qi * ur[k] - ndzi;
+                if(!(sqrt(er * er + ei * ei) <= limit_err)) {
+                    valid = false;
+                    break;
+                }
+            }
+            if(!valid) {
+                break;
+            }
+            ar = nar; ai = nai;
+            br = nbr; bi = nbi;
+            cr = ncr; ci = nci;
+            skip = n + 1;
+        }
+        a_real = ar; a_imag = ai;
+        b_real = br; b_imag = bi;
+        c_real = cr; c_imag = ci;
+    }
+
+    template<typename R>
+    void SeriesApproximation<R>::evaluate(R const& dc_real, R const& dc_imag, R& dz_real, R& dz_imag) const {
+        R ur = dc_real / radius;
+        R ui = dc_imag / radius;
+        // ((C u + B) u + A) u
+        R tr = c_real * ur - c_imag * ui + b_real;
+        R ti = c_real * ui + c_imag * ur + b_imag;
+        R sr = tr * ur - ti * ui + a_real;
+        R si = tr * ui + ti * ur + a_imag;
+        dz_real = sr * ur - si * ui;
+        dz_imag = sr * ui + si * ur;
+    }
+
+    template<typename D>
+    PerturbationKernel<D>::PerturbationKernel(BigFixed const& center_real, BigFixed const& center_imag,
+                                              size_t max_times) :
+        ref_real(center_real), ref_imag(negated(center_imag)), max_times(max_times), orbit(),
+        series_half_width(0), series_half_height(0), series_spacing(0), series(),
+        bla_dc_max(0), bla() {
+    }
+
+    template<typename D>
+    void PerturbationKernel<D>::enableBla(D dc_max) {
+        bla_dc_max = dc_max;
+    }
+
+    template<typename D>
+    void PerturbationKernel<D>::enableSeries(D half_width, D half_height, D pixel_spacing) {
+        series_half_width = half_width;
+        series_half_height = half_height;
+        series_spacing = pixel_spacing;
+    }
+
+    template<typename D>
+    void PerturbationKernel<D>::prepare(CancelToken const& token) {
+        if(!orbit.compute(ref_real, ref_imag, max_times, token)) {
+            return;
+        }
+        if(series_spacing > D(0)) {
+            series.compute(orbit, series_half_width, series_half_height, series_spacing, max_times);
+        }
+        if(bla_dc_max > D(0)) {
+            bla.build(orbit, bla_dc_max);
+        }
+    }
+
+    template<typename D>
+    size_t PerturbationKernel<D>::calcPoint(D const& dc_real, D const& dc_imag, size_t max_times,
+                                            CalcStats& stats) {
+        const double* ref_r = orbit.real();
+        const double* ref_i = orbit.imag();
+        const int last = orbit.size() - 1;
+        D dz_real = 0;
+        D dz_imag = 0;
+        size_t skip = qMin(series.getSkip(), max_times);
+        if(skip > 0) {
+            series.evaluate(dc_real, dc_imag, dz_real, dz_imag);
+        }
+        int m = (int)skip;
+        const bool use_bla = !bla.isEmpty();
+        // n为已完成的迭代次数, 第n次迭代后逃逸时返回n - 1
+        size_t n = skip;
+        while(n < max_times) {
+            D dz_norm = dz_real * dz_real + dz_imag * dz_imag;
+            int length;
+            const typename BlaTable<D>::Step* step =
+                    use_bla ? bla.lookup(m, dz_norm, max_times - n, length) : NULL;
+            if(step) {
+                // 线性段: dz = A dz + B dc
+                D ndz_real = step->a_real * dz_real - step->a_imag * dz_imag
+                        + step->b_real * dc_real - step->b_imag * dc_imag;
+                D ndz_imag = step->a_real * dz_imag + step->a_imag * dz_real
+                        + step->b_real * dc_imag + step->b_imag * dc_real;
+                dz_real = ndz_real;
+                dz_imag = ndz_imag;
+                m += length;
+                n += length;
+                stats.bla_jumps++;
+                stats.bla_skipped += length;
+            } else {
+                D a_real = 2 * ref_r[m] + dz_real;
+                D a_imag = 2 * ref_i[m] + dz_imag;
+                D ndz_real = a_real * dz_real - a_imag * dz_imag + dc_real;
+                D ndz_imag = a_real * dz_imag + a_imag * dz_real + dc_imag;
+                dz_real = ndz_real;
+                dz_imag = ndz_imag;
+                m++;
+                n++;
+            }
+            // 逃逸判断只需double; 偏移很小时转为double下溢为0, 不影响判断
+            double z_real = ref_r[m] + toDouble(dz_real);
+            double z_imag = ref_i[m] + toDouble(dz_imag);
+            double z_norm = z_real * z_real + z_imag * z_imag;
+            if(z_norm > 4) {
+                return n - 1;
+            }
+            if(D(z_norm) < dz_real * dz_real + dz_imag * dz_imag || m == last) {
+                dz_real = ref_r[m] + dz_real;
+                dz_imag = ref_i[m] + dz_imag;
+                m = 0;
+                stats.rebases++;
+            }
+        }
+        return max_times;
+    }
+
+    template<typename D>
+    void PerturbationKernel<D>::calcRow(const D* c_real, const D* c_imag, size_t* times, int n,
+                                        size_t max_times, CalcOptions const& opt, CalcStats& stats) {
+        Q_UNUSED(opt)
+        stats.pixels += n;
+        if(orbit.size() < 2) {
+            for(int i = 0; i < n; i++) {
+                times[i] = 0;
+            }
+            return;
+        }
+        stats.skipped += (quint64)qMin(series.getSkip(), max_times) * n;
+        for(int i = 0; i < n; i++) {
+            times[i] = calcPoint(c_real[i], c_imag[i], max_times, stats);
+        }
+    }
+
+    template class SeriesApproximation<double>;
+    template class SeriesApproximation<FloatExp>;
+    template class PerturbationKernel<double>;
+    template class PerturbationKernel<FloatExp>;
+}
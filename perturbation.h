@@ -0,0 +1,99 @@
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+#include <QVector>
+#include "bigfixed.h"
+#include "bla.h"
+#include "floatexp.h"
+#include "mandelbrot.h"
+
+namespace Mandelbrot {
+
+    // 像素间距低于此值时偏移改用FloatExp: 偏移的平方(BLA半径, 重定基判断)在double中将下溢
+    const double FLOATEXP_SPACING = 1e-140;
+
+    /**
+     * @brief 参考轨道: 以高精度迭代参考点C, 保存Z_0..Z_n的double近似
+     * 参考点逃逸时保存到逃逸的那一次为止
+     */
+    class ReferenceOrbit {
+    private:
+        QVector<double> z_real;
+        QVector<double> z_imag;
+    public:
+        // 被取消时返回false
+        bool compute(BigFixed const& c_real, BigFixed const& c_imag, size_t max_times, CancelToken const& token);
+        int size() const { return z_real.size(); }
+        const double* real() const { return z_real.constData(); }
+        const double* imag() const { return z_imag.constData(); }
+    };
+
+    /**
+     * @brief 级数近似: dz_n ≈ A_n dc + B_n dc^2 + C_n dc^3, 系数沿参考轨道每帧计算一次,
+     * 各点直接由多项式得到第skip次的偏移, 跳过前面的迭代
+     * 系数按dc的最大模长r归一化保存(A r, B r^2, C r^3), 计算时代入u = dc / r, 避免深度缩放时下溢
+     * 以图像四角与四边中点为探测点同步做逐次迭代, 多项式与探测点的偏差超过像素间距的一定比例即停止
+     * R为偏移与系数的类型
+     */
+    template<typename R>
+    class SeriesApproximation {
+    private:
+        size_t skip;
+        R a_real, a_imag;
+        R b_real, b_imag;
+        R c_real, c_imag;
+        R radius;
+    public:
+        // 允许的偏差, 以像素间距经导数A放大后的长度为单位
+        static const double TOLERANCE;
+
+        SeriesApproximation();
+        // half_width, half_height为图像半宽半高, 跳过次数不超过limit
+        void compute(ReferenceOrbit const& orbit, R half_width, R half_height, R pixel_spacing, size_t limit);
+        size_t getSkip() const { return skip; }
+        void evaluate(R const& dc_real, R const& dc_imag, R& dz_real, R& dz_imag) const;
+    };
+
+    /**
+     * @brief 扰动核心: 各点只以低精度迭代相对参考轨道的偏移dz,
+     * dz' = (2Z + dz)dz + dc, 用以突破double的缩放深度
+     * 当|Z + dz| < |dz|(偏移将失去精度, 即出现毛刺)或参考轨道用尽时,
+     * 以Z + dz作为新的偏移并回到参考轨道起点(重定基), 因而只需一条参考轨道
+     * 可选用级数近似跳过前段迭代, 以及用BLA表成段跳过线性化成立的迭代
+     * D为偏移dz与dc的类型: double可缩放到FLOATEXP_SPACING, 更深时用FloatExp, 参考轨道仍为double
+     */
+    template<typename D>
+    class PerturbationKernel : public Kernel<D> {
+    private:
+        const BigFixed ref_real;
+        const BigFixed ref_imag;
+        const size_t max_times;
+        ReferenceOrbit orbit;
+        D series_half_width;
+        D series_half_height;
+        D series_spacing;
+        SeriesApproximation<D> series;
+        D bla_dc_max;
+        BlaTable<D> bla;
+
+        size_t calcPoint(D const& dc_real, D const& dc_imag, size_t max_times, CalcStats& stats);
+
+    public:
+        // 参考点为图像中心, 虚部按读取器的坐标约定取相反数
+        PerturbationKernel(BigFixed const& center_real, BigFixed const& center_imag, size_t max_times);
+
+        virtual void prepare(CancelToken const& token);
+        virtual void calcRow(const D* c_real, const D* c_imag, size_t* times, int n, size_t max_times,
+                             CalcOptions const& opt, CalcStats& stats);
+
+        // 启用级数近似, 参数为图像半宽半高与像素间距
+        void enableSeries(D half_width, D half_height, D pixel_spacing);
+        // 启用BLA, 级数近似跳过的部分之后按BLA表成段跳过, dc_max为图像内dc的最大模长
+        void enableBla(D dc_max);
+
+        int getReferenceLength() const { return orbit.size(); }
+        size_t getSeriesSkip() const { return series.getSkip(); }
+    };
+}
+
+#endif // PERTURBATION_H
@@ -0,0 +1,190 @@
+#ifndef QUADDOUBLE_H
+#define QUADDOUBLE_H
+
+#include "doubledouble.h"
+
+namespace Mandelbrot {
+
+    namespace Eft {
+        // (a, b, c) -> a + b + c, 结果依次存回a, b, c
+        inline void threeSum(double& a, double& b, double& c) {
+            double t1, t2, t3;
+            t1 = twoSum(a, b, t2);
+            a = twoSum(c, t1, t3);
+            b = twoSum(t2, t3, c);
+        }
+
+        // 同threeSum, 只保留前两项
+        inline void threeSum2(double& a, double& b, double c) {
+            double t1, t2, t3;
+            t1 = twoSum(a, b, t2);
+            a = twoSum(c, t1, t3);
+            b = t2 + t3;
+        }
+
+        /**
+         * @brief 将五项和规格化为四项
+         * 先自低向高、再自高向低各传一遍; 省去了QD原实现中对零分量的分支,
+         * 极少数情况下损失末几位, 换来无分支的运算
+         */
+        inline void renorm(double& c0, double& c1, double& c2, double& c3, double c4) {
+            double s = quickTwoSum(c3, c4, c4);
+            s = quickTwoSum(c2, s, c3);
+            s = quickTwoSum(c1, s, c2);
+            c0 = quickTwoSum(c0, s, c1);
+            c1 = quickTwoSum(c1, c2, c2);
+            c2 = quickTwoSum(c2, c3, c3);
+            c3 += c4;
+        }
+    }
+
+    /**
+     * @brief 四双精度数, 值为x[0] + x[1] + x[2] + x[3], 约212位有效数字
+     * 加法与乘法采用QD库的快速(sloppy)算法, 误差相对于操作数而非结果,
+     * 对模长不超过2的迭代足够
+     */
+    class QuadDouble {
+    public:
+        double x[4];
+
+        QuadDouble() {
+            x[0] = x[1] = x[2] = x[3] = 0;
+        }
+        QuadDouble(double a) {
+            x[0] = a;
+            x[1] = x[2] = x[3] = 0;
+        }
+        QuadDouble(double c0, double c1, double c2, double c3) {
+            Eft::renorm(c0, c1, c2, c3, 0);
+            x[0] = c0;
+            x[1] = c1;
+            x[2] = c2;
+            x[3] = c3;
+        }
+        double toDouble() const { return x[0] + x[1]; }
+
+        QuadDouble operator-() const {
+            QuadDouble r;
+            for(int i = 0; i < 4; i++) {
+                r.x[i] = -x[i];
+            }
+            return r;
+        }
+    };
+
+    inline QuadDouble operator+(QuadDouble const& a, QuadDouble const& b) {
+        double t0, t1, t2, t3;
+        double s0 = Eft::twoSum(a.x[0], b.x[0], t0);
+        double s1 = Eft::twoSum(a.x[1], b.x[1], t1);
+        double s2 = Eft::twoSum(a.x[2], b.x[2], t2);
+        double s3 = Eft::twoSum(a.x[3], b.x[3], t3);
+        s1 = Eft::twoSum(s1, t0, t0);
+        Eft::threeSum(s2, t0, t1);
+        Eft::threeSum2(s3, t0, t2);
+        t0 = t0 + t1 + t3;
+        Eft::renorm(s0, s1, s2, s3, t0);
+        QuadDouble r;
+        r.x[0] = s0;
+        r.x[1] = s1;
+        r.x[2] = s2;
+        r.x[3] = s3;
+        return r;
+    }
+
+    inline QuadDouble operator-(QuadDouble const& a, QuadDouble const& b) {
+        return a + -b;
+    }
+
+    inline QuadDouble operator*(QuadDouble const& a, QuadDouble const& b) {
+        double q0, q1, q2, q3, q4, q5;
+        double p0 = Eft::twoProd(a.x[0], b.x[0], q0);
+        double p1 = Eft::twoProd(a.x[0], b.x[1], q1);
+        double p2 = Eft::twoProd(a.x[1], b.x[0], q2);
+        double p3 = Eft::twoProd(a.x[0], b.x[2], q3);
+        double p4 = Eft::twoProd(a.x[1], b.x[1], q4);
+        double p5 = Eft::twoProd(a.x[2], b.x[0], q5);
+
+        // O(eps)项
+        Eft::threeSum(p1, p2, q0);
+
+        // O(eps^2)项: (p2, q1, q2) + (p3, p4, p5)
+        Eft::threeSum(p2, q1, q2);
+        Eft::threeSum(p3, p4, p5);
+        double t0, t1;
+        double s0 = Eft::twoSum(p2, p3, t0);
+        double s1 = Eft::twoSum(q1, p4, t1);
+        double s2 = q2 + p5;
+        s1 = Eft::twoSum(s1, t0, t0);
+        s2 += t0 + t1;
+
+        // O(eps^3)项
+        s1 += a.x[0] * b.x[3] + a.x[1] * b.x[2] + a.x[2] * b.x[1] + a.x[3] * b.x[0] + q0 + q3 + q4 + q5;
+        Eft::renorm(p0, p1, s0, s1, s2);
+        QuadDouble r;
+        r.x[0] = p0;
+        r.x[1] = p1;
+        r.x[2] = s0;
+        r.x[3] = s1;
+        return r;
+    }
+
+    inline QuadDouble operator*(QuadDouble const& a, double b) {
+        double q0, q1, q2;
+        double p0 = Eft::twoProd(a.x[0], b, q0);
+        double p1 = Eft::twoProd(a.x[1], b, q1);
+        double p2 = Eft::twoProd(a.x[2], b, q2);
+        double p3 = a.x[3] * b;
+        double s2;
+        double s1 = Eft::twoSum(q0, p1, s2);
+        Eft::threeSum(s2, q1, p2);
+        Eft::threeSum2(q1, q2, p3);
+        double s3 = q1;
+        double s4 = q2 + p2;
+        Eft::renorm(p0, s1, s2, s3, s4);
+        QuadDouble r;
+        r.x[0] = p0;
+        r.x[1] = s1;
+        r.x[2] = s2;
+        r.x[3] = s3;
+        return r;
+    }
+
+    inline QuadDouble operator*(double a, QuadDouble const& b) {
+        return b * a;
+    }
+
+    inline QuadDouble operator/(QuadDouble const& a, QuadDouble const& b) {
+        // 长除法, 每次以最高部分估商
+        double q0 = a.x[0] / b.x[0];
+        QuadDouble r = a - b * q0;
+        double q1 = r.x[0] / b.x[0];
+        r = r - b * q1;
+        double q2 = r.x[0] / b.x[0];
+        r = r - b * q2;
+        double q3 = r.x[0] / b.x[0];
+        r = r - b * q3;
+        double q4 = r.x[0] / b.x[0];
+        Eft::renorm(q0, q1, q2, q3, q4);
+        return QuadDouble(q0, q1, q2, q3);
+    }
+
+    inline bool operator<(QuadDouble const& a, QuadDouble const& b) {
+        for(int i = 0; i < 4; i++) {
+            if(a.x[i] != b.x[i]) {
+                return a.x[i] < b.x[i];
+            }
+        }
+        return false;
+    }
+    inline bool operator>(QuadDouble const& a, QuadDouble const& b) {
+        return b < a;
+    }
+    inline bool operator<=(QuadDouble const& a, QuadDouble const& b) {
+        return !(b < a);
+    }
+    inline bool operator>=(QuadDouble const& a, QuadDouble const& b) {
+        return !(a < b);
+    }
+}
+
+#endif // QUADDOUBLE_H
@@ -0,0 +1,389 @@
+#include "simdkernel.h"
+#include "mandelbrot.h"
+
+/**
+ * 向量核心依赖函数级target属性与__builtin_cpu_supports,
+ * 旧编译器(如mingw-GCC 4.4)或非x86平台下仅使用标量回退
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define MANDELBROT_X86_SIMD 1
+#include <immintrin.h>
+// AVX-512F隐含FMA, 禁止乘加融合以保证与标量结果逐位一致
+#if !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+#endif
+
+namespace Mandelbrot {
+
+#ifdef MANDELBROT_X86_SIMD
+
+    /**
+     * @brief 4点一组迭代, 逃逸的通道冻结z并停止计数
+     * 计数方式与calc<double>一致: 第times次迭代后逃逸则结果为times
+     * 各通道迭代步数相同, 周期检测的记录点(2的幂次)对所有通道一致, 可整组进行
+     * z_real非NULL时从给定的z出发续算, 结束时写回最终z, 周期检测命中的通道实部写为INSIDE_MARK
+     */
+    __attribute__((target("avx2")))
+    static int calc4_avx2(const double* c_real, const double* c_imag, size_t* times, size_t max_times,
+                          double period_eps, double* z_real, double* z_imag) {
+        const __m256d cr = _mm256_loadu_pd(c_real);
+        const __m256d ci = _mm256_loadu_pd(c_imag);
+        const __m256d two = _mm256_set1_pd(2.0);
+        const __m256d four = _mm256_set1_pd(4.0);
+        const __m256d eps = _mm256_set1_pd(period_eps);
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        const __m256i one = _mm256_set1_epi64x(1);
+        const bool use_period = period_eps > 0;
+        __m256d zr = z_real ? _mm256_loadu_pd(z_real) : _mm256_setzero_pd();
+        __m256d zi = z_imag ? _mm256_loadu_pd(z_imag) : _mm256_setzero_pd();
+        __m256d sr = zr;
+        __m256d si = zi;
+        __m256d active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        __m256d periodic = _mm256_setzero_pd();
+        __m256i cnt = _mm256_setzero_si256();
+        size_t check = 1;
+        size_t step = 0;
+        for(size_t t = 0; t < max_times; t++) {
+            __m256d nzr = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi)), cr);
+            __m256d nzi = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, zr), zi), ci);
+            zr = _mm256_blendv_pd(zr, nzr, active);
+            zi = _mm256_blendv_pd(zi, nzi, active);
+            __m256d mag = _mm256_add_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi));
+            active = _mm256_andnot_pd(_mm256_cmp_pd(mag, four, _CMP_GT_OQ), active);
+            if(use_period) {
+                __m256d dr = _mm256_andnot_pd(sign, _mm256_sub_pd(zr, sr));
+                __m256d di = _mm256_andnot_pd(sign, _mm256_sub_pd(zi, si));
+                __m256d hit = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(dr, eps, _CMP_LT_OQ),
+                                                          _mm256_cmp_pd(di, eps, _CMP_LT_OQ)), active);
+                periodic = _mm256_or_pd(periodic, hit);
+                active = _mm256_andnot_pd(hit, active);
+                if(++step == check) {
+                    step = 0;
+                    check <<= 1;
+                    sr = zr;
+                    si = zi;
+                }
+            }
+            if(_mm256_movemask_pd(active) == 0) {
+                break;
+            }
+            cnt = _mm256_add_epi64(cnt, _mm256_and_si256(_mm256_castpd_si256(active), one));
+        }
+        if(z_real) {
+            _mm256_storeu_pd(z_real, _mm256_blendv_pd(zr, _mm256_set1_pd(INSIDE_MARK), periodic));
+            _mm256_storeu_pd(z_imag, zi);
+        }
+        long long out[4];
+        _mm256_storeu_si256((__m256i*)out, cnt);
+        int mask = _mm256_movemask_pd(periodic);
+        int periodic_total = 0;
+        for(int i = 0; i < 4; i++) {
+            if(mask & (1 << i)) {
+                times[i] = max_times;
+                periodic_total++;
+            } else {
+                times[i] = (size_t)out[i];
+            }
+        }
+        return periodic_total;
+    }
+
+    __attribute__((target("avx512f")))
+    static int calc8_avx512(const double* c_real, const double* c_imag, size_t* times, size_t max_times,
+                            double period_eps, double* z_real, double* z_imag) {
+        const __m512d cr = _mm512_loadu_pd(c_real);
+        const __m512d ci = _mm512_loadu_pd(c_imag);
+        const __m512d two = _mm512_set1_pd(2.0);
+        const __m512d four = _mm512_set1_pd(4.0);
+        const __m512d eps = _mm512_set1_pd(period_eps);
+        const __m512i one = _mm512_set1_epi64(1);
+        const bool use_period = period_eps > 0;
+        __m512d zr = z_real ? _mm512_loadu_pd(z_real) : _mm512_setzero_pd();
+        __m512d zi = z_imag ? _mm512_loadu_pd(z_imag) : _mm512_setzero_pd();
+        __m512d sr = zr;
+        __m512d si = zi;
+        __mmask8 active = 0xff;
+        __mmask8 periodic = 0;
+        __m512i cnt = _mm512_setzero_si512();
+        size_t check = 1;
+        size_t step = 0;
+        for(size_t t = 0; t < max_times; t++) {
+            __m512d nzr = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(zr, zr), _mm512_mul_pd(zi, zi)), cr);
+            __m512d nzi = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, zr), zi), ci);
+            zr = _mm512_mask_mov_pd(zr, active, nzr);
+            zi = _mm512_mask_mov_pd(zi, active, nzi);
+            __m512d mag = _mm512_add_pd(_mm512_mul_pd(zr, zr), _mm512_mul_pd(zi, zi));
+            active &= (__mmask8)~_mm512_cmp_pd_mask(mag, four, _CMP_GT_OQ);
+            if(use_period) {
+                __m512d dr = _mm512_abs_pd(_mm512_sub_pd(zr, sr));
+                __m512d di = _mm512_abs_pd(_mm512_sub_pd(zi, si));
+                __mmask8 hit = _mm512_mask_cmp_pd_mask(active, dr, eps, _CMP_LT_OQ)
+                        & _mm512_cmp_pd_mask(di, eps, _CMP_LT_OQ);
+                periodic |= hit;
+                active &= (__mmask8)~hit;
+                if(++step == check) {
+                    step = 0;
+                    check <<= 1;
+                    sr = zr;
+                    si = zi;
+                }
+            }
+            if(active == 0) {
+                break;
+            }
+            cnt = _mm512_mask_add_epi64(cnt, active, cnt, one);
+        }
+        if(z_real) {
+            _mm512_storeu_pd(z_real, _mm512_mask_mov_pd(zr, periodic, _mm512_set1_pd(INSIDE_MARK)));
+            _mm512_storeu_pd(z_imag, zi);
+        }
+        long long out[8];
+        _mm512_storeu_si512((void*)out, cnt);
+        int periodic_total = 0;
+        for(int i = 0; i < 8; i++) {
+            if(periodic & (1 << i)) {
+                times[i] = max_times;
+                periodic_total++;
+            } else {
+                times[i] = (size_t)out[i];
+            }
+        }
+        return periodic_total;
+    }
+
+    /**
+     * @brief float版本, 每组8点, 计数用32位整数
+     */
+    __attribute__((target("avx2")))
+    static int calc8_avx2(const float* c_real, const float* c_imag, size_t* times, size_t max_times,
+                          float period_eps, float* z_real, float* z_imag) {
+        const __m256 cr = _mm256_loadu_ps(c_real);
+        const __m256 ci = _mm256_loadu_ps(c_imag);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 four = _mm256_set1_ps(4.0f);
+        const __m256 eps = _mm256_set1_ps(period_eps);
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        const __m256i one = _mm256_set1_epi32(1);
+        const bool use_period = period_eps > 0;
+        __m256 zr = z_real ? _mm256_loadu_ps(z_real) : _mm256_setzero_ps();
+        __m256 zi = z_imag ? _mm256_loadu_ps(z_imag) : _mm256_setzero_ps();
+        __m256 sr = zr;
+        __m256 si = zi;
+        __m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256 periodic = _mm256_setzero_ps();
+        __m256i cnt = _mm256_setzero_si256();
+        size_t check = 1;
+        size_t step = 0;
+        for(size_t t = 0; t < max_times; t++) {
+            __m256 nzr = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(zr, zr), _mm256_mul_ps(zi, zi)), cr);
+            __m256 nzi = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, zr), zi), ci);
+            zr = _mm256_blendv_ps(zr, nzr, active);
+            zi = _mm256_blendv_ps(zi, nzi, active);
+            __m256 mag = _mm256_add_ps(_mm256_mul_ps(zr, zr), _mm256_mul_ps(zi, zi));
+            active = _mm256_andnot_ps(_mm256_cmp_ps(mag, four, _CMP_GT_OQ), active);
+            if(use_period) {
+                __m256 dr = _mm256_andnot_ps(sign, _mm256_sub_ps(zr, sr));
+                __m256 di = _mm256_andnot_ps(sign, _mm256_sub_ps(zi, si));
+                __m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(dr, eps, _CMP_LT_OQ),
+                                                         _mm256_cmp_ps(di, eps, _CMP_LT_OQ)), active);
+                periodic = _mm256_or_ps(periodic, hit);
+                active = _mm256_andnot_ps(hit, active);
+                if(++step == check) {
+                    step = 0;
+                    check <<= 1;
+                    sr = zr;
+                    si = zi;
+                }
+            }
+            if(_mm256_movemask_ps(active) == 0) {
+                break;
+            }
+            cnt = _mm256_add_epi32(cnt, _mm256_and_si256(_mm256_castps_si256(active), one));
+        }
+        if(z_real) {
+            _mm256_storeu_ps(z_real, _mm256_blendv_ps(zr, _mm256_set1_ps(INSIDE_MARK), periodic));
+            _mm256_storeu_ps(z_imag, zi);
+        }
+        int out[8];
+        _mm256_storeu_si256((__m256i*)out, cnt);
+        int mask = _mm256_movemask_ps(periodic);
+        int periodic_total = 0;
+        for(int i = 0; i < 8; i++) {
+            if(mask & (1 << i)) {
+                times[i] = max_times;
+                periodic_total++;
+            } else {
+                times[i] = (size_t)(unsigned)out[i];
+            }
+        }
+        return periodic_total;
+    }
+
+    __attribute__((target("avx512f")))
+    static int calc16_avx512(const float* c_real, const float* c_imag, size_t* times, size_t max_times,
+                             float period_eps, float* z_real, float* z_imag) {
+        const __m512 cr = _mm512_loadu_ps(c_real);
+        const __m512 ci = _mm512_loadu_ps(c_imag);
+        const __m512 two = _mm512_set1_ps(2.0f);
+        const __m512 four = _mm512_set1_ps(4.0f);
+        const __m512 eps = _mm512_set1_ps(period_eps);
+        const __m512i one = _mm512_set1_epi32(1);
+        const bool use_period = period_eps > 0;
+        __m512 zr = z_real ? _mm512_loadu_ps(z_real) : _mm512_setzero_ps();
+        __m512 zi = z_imag ? _mm512_loadu_ps(z_imag) : _mm512_setzero_ps();
+        __m512 sr = zr;
+        __m512 si = zi;
+        __mmask16 active = 0xffff;
+        __mmask16 periodic = 0;
+        __m512i cnt = _mm512_setzero_si512();
+        size_t check = 1;
+        size_t step = 0;
+        for(size_t t = 0; t < max_times; t++) {
+            __m512 nzr = _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(zr, zr), _mm512_mul_ps(zi, zi)), cr);
+            __m512 nzi = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(two, zr), zi), ci);
+            zr = _mm512_mask_mov_ps(zr, active, nzr);
+            zi = _mm512_mask_mov_ps(zi, active, nzi);
+            __m512 mag = _mm512_add_ps(_mm512_mul_ps(zr, zr), _mm512_mul_ps(zi, zi));
+            active &= (__mmask16)~_mm512_cmp_ps_mask(mag, four, _CMP_GT_OQ);
+            if(use_period) {
+                __m512 dr = _mm512_abs_ps(_mm512_sub_ps(zr, sr));
+                __m512 di = _mm512_abs_ps(_mm512_sub_ps(zi, si));
+                __mmask16 hit = _mm512_mask_cmp_ps_mask(active, dr, eps, _CMP_LT_OQ)
+                        & _mm512_cmp_ps_mask(di, eps, _CMP_LT_OQ);
+                periodic |= hit;
+                active &= (__mmask16)~hit;
+                if(++step == check) {
+                    step = 0;
+                    check <<= 1;
+                    sr = zr;
+                    si = zi;
+                }
+            }
+            if(active == 0) {
+                break;
+            }
+            cnt = _mm512_mask_add_epi32(cnt, active, cnt, one);
+        }
+        if(z_real) {
+            _mm512_storeu_ps(z_real, _mm512_mask_mov_ps(zr, periodic, _mm512_set1_ps(INSIDE_MARK)));
+            _mm512_storeu_ps(z_imag, zi);
+        }
+        int out[16];
+        _mm512_storeu_si512((void*)out, cnt);
+        int periodic_total = 0;
+        for(int i = 0; i < 16; i++) {
+            if(periodic & (1 << i)) {
+                times[i] = max_times;
+                periodic_total++;
+            } else {
+                times[i] = (size_t)(unsigned)out[i];
+            }
+        }
+        return periodic_total;
+    }
+
+    static SimdLevel detectSimdLevel() {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f")) {
+            return SIMD_AVX512;
+        }
+        if(__builtin_cpu_supports("avx2")) {
+            return SIMD_AVX2;
+        }
+        return SIMD_NONE;
+    }
+
+#else
+
+    static SimdLevel detectSimdLevel() {
+        return SIMD_NONE;
+    }
+
+#endif
+
+    SimdLevel simdLevel() {
+        // 局部静态量只初始化一次, gcc默认(-fthreadsafe-statics)对并发的首次调用加锁
+        static const SimdLevel level = detectSimdLevel();
+        return level;
+    }
+
+    const char* simdLevelName(SimdLevel level) {
+        switch(level) {
+        case SIMD_AVX512: return "AVX-512";
+        case SIMD_AVX2: return "AVX2";
+        default: return "scalar";
+        }
+    }
+
+    int calcBatch(const double* c_real, const double* c_imag, size_t* times, int n, size_t max_times,
+                  double period_eps, double* z_real, double* z_imag) {
+        int i = 0;
+        int periodic_total = 0;
+#ifdef MANDELBROT_X86_SIMD
+        SimdLevel level = simdLevel();
+        if(level >= SIMD_AVX512) {
+            for(; i + 8 <= n; i += 8) {
+                periodic_total += calc8_avx512(c_real + i, c_imag + i, times + i, max_times, period_eps,
+                                               z_real ? z_real + i : NULL, z_imag ? z_imag + i : NULL);
+            }
+        }
+        if(level >= SIMD_AVX2) {
+            for(; i + 4 <= n; i += 4) {
+                periodic_total += calc4_avx2(c_real + i, c_imag + i, times + i, max_times, period_eps,
+                                               z_real ? z_real + i : NULL, z_imag ? z_imag + i : NULL);
+            }
+        }
+#endif
+        if(z_real) {
+            return periodic_total + calcRowFrom<double>(c_real + i, c_imag + i, z_real + i, z_imag + i,
+                                                     times + i, n - i, max_times, period_eps);
+        }
+        for(; i < n; i++) {
+            if(period_eps > 0) {
+                bool periodic;
+                times[i] = calc<double>(c_real[i], c_imag[i], max_times, period_eps, periodic);
+                if(periodic) periodic_total++;
+            } else {
+                times[i] = calc<double>(c_real[i], c_imag[i], max_times);
+            }
+        }
+        return periodic_total;
+    }
+
+    int calcBatch(const float* c_real, const float* c_imag, size_t* times, int n, size_t max_times,
+                  float period_eps, float* z_real, float* z_imag) {
+        int i = 0;
+        int periodic_total = 0;
+#ifdef MANDELBROT_X86_SIMD
+        SimdLevel level = simdLevel();
+        if(level >= SIMD_AVX512) {
+            for(; i + 16 <= n; i += 16) {
+                periodic_total += calc16_avx512(c_real + i, c_imag + i, times + i, max_times, period_eps,
+                                               z_real ? z_real + i : NULL, z_imag ? z_imag + i : NULL);
+            }
+        }
+        if(level >= SIMD_AVX2) {
+            for(; i + 8 <= n; i += 8) {
+                periodic_total += calc8_avx2(c_real + i, c_imag + i, times + i, max_times, period_eps,
+                                               z_real ? z_real + i : NULL, z_imag ? z_imag + i : NULL);
+            }
+        }
+#endif
+        if(z_real) {
+            return periodic_total + calcRowFrom<float>(c_real + i, c_imag + i, z_real + i, z_imag + i,
+                                                     times + i, n - i, max_times, period_eps);
+        }
+        for(; i < n; i++) {
+            if(period_eps > 0) {
+                bool periodic;
+                times[i] = calc<float>(c_real[i], c_imag[i], max_times, period_eps, periodic);
+                if(periodic) periodic_total++;
+            } else {
+                times[i] = calc<float>(c_real[i], c_imag[i], max_times);
+            }
+        }
+        return periodic_total;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef SIMDKERNEL_H
+#define SIMDKERNEL_H
+
+#include <cstddef>
+
+namespace Mandelbrot {
+
+    /**
+     * @brief 向量指令集等级, 运行时按CPU检测选取
+     */
+    enum SimdLevel {
+        SIMD_NONE = 0,
+        SIMD_AVX2 = 1,
+        SIMD_AVX512 = 2,
+    };
+
+    SimdLevel simdLevel();
+    const char* simdLevelName(SimdLevel level);
+
+    /**
+     * @brief 未逃逸的点|z| <= 2, 续算时以z实部为此值标记已判定在集合内的点
+     */
+    enum { INSIDE_MARK = 4 };
+
+    /**
+     * @brief 批量计算n个点的逃逸次数, 结果与calc<double>逐点计算一致
+     * AVX2每组4点, AVX-512每组8点, 不支持时回退到calc<double>
+     * period_eps > 0时启用周期检测, 返回因周期检测提前结束的点数
+     * z_real/z_imag非NULL时各点从给定的z出发续算并写回最终z, times为本次的迭代次数
+     */
+    int calcBatch(const double* c_real, const double* c_imag, size_t* times, int n, size_t max_times,
+                  double period_eps = 0, double* z_real = NULL, double* z_imag = NULL);
+
+    /**
+     * @brief float版本, 结果与calc<float>逐点计算一致, 向量宽度加倍: AVX2每组8点, AVX-512每组16点
+     */
+    int calcBatch(const float* c_real, const float* c_imag, size_t* times, int n, size_t max_times,
+                  float period_eps = 0, float* z_real = NULL, float* z_imag = NULL);
+}
+
+#endif // SIMDKERNEL_H
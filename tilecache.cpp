@@ -0,0 +1,124 @@
+#include "tilecache.h"
+#include <cmath>
+#include <cstring>
+
+namespace Mandelbrot {
+
+    PlaneTileKeyer::PlaneTileKeyer(QString const& prefix, double lux, double luy, double width, double height,
+                                   int pwidth, int pheight) :
+        TileKeyer(prefix), lux(lux), luy(luy), width(width), height(height), pwidth(pwidth), pheight(pheight) {
+    }
+
+    /**
+     * 坐标写为以像素间距计的格点序号与不足一格的相位(1/PHASE格), 两个视图在同一格点上算出的坐标只差末几位,
+     * 写出的键仍然相同
+     */
+    QString PlaneTileKeyer::key(int x0, int y0, int w, int h) const {
+        // 与RectangleImageReader计算各点坐标的式子相同
+        double c_real = width * x0 / (double)(pwidth - 1) + lux;
+        double c_imag = height * y0 / (double)(pheight - 1) - luy;
+        return prefix + "|" + latticeText(c_real / (width / (pwidth - 1))) + ","
+                + latticeText(c_imag / (height / (pheight - 1))) + "," + QString::number(w) + "x" + QString::number(h);
+    }
+
+    QString PlaneTileKeyer::latticeText(double q) {
+        double n = std::floor(q + 0.5);
+        int phase = (int)std::floor((q - n) * PHASE + 0.5);
+        return QString::number(n, 'f', 0) + ":" + QString::number(phase);
+    }
+
+    BigTileKeyer::BigTileKeyer(QString const& prefix, BigFixed const& center_real, BigFixed const& center_imag,
+                               FloatExp const& width, FloatExp const& height, int pwidth, int pheight) :
+        TileKeyer(prefix), center_real(center_real), center_imag(center_imag), width(width), height(height),
+        pwidth(pwidth), pheight(pheight) {
+    }
+
+    /**
+     * 坐标截到不超过像素间距的1/1024的2的幂, 两个视图在同一格点上算出的坐标只在更低的位有舍入差, 写出的键仍然相同
+     */
+    int BigTileKeyer::keyBits(FloatExp const& extent, int pixels) {
+        FloatExp spacing = extent / (double)(pixels - 1);
+        return PHASE_BITS - spacing.e;
+    }
+
+    QString BigTileKeyer::key(int x0, int y0, int w, int h) const {
+        const int limbs = center_real.fracLimbs();
+        FloatExp dx = width * ((double)x0 / (pwidth - 1)) - width * 0.5;
+        FloatExp dy = height * 0.5 - height * ((double)y0 / (pheight - 1));
+        BigFixed c_real(limbs), c_imag(limbs);
+        BigFixed::add(center_real, BigFixed(dx, limbs), c_real);
+        BigFixed::add(center_imag, BigFixed(dy, limbs), c_imag);
+        return prefix + "|" + c_real.toHexString(keyBits(width, pwidth)) + "," + c_imag.toHexString(keyBits(height, pheight))
+                + "," + QString::number(w) + "x" + QString::number(h);
+    }
+
+    TileCache::TileCache(int capacity_kb) : mutex(), cache(capacity_kb), store(NULL) {
+    }
+
+    void TileCache::setCapacity(int capacity_kb) {
+        QMutexLocker locker(&mutex);
+        cache.setMaxCost(capacity_kb);
+    }
+
+    int TileCache::getCapacity() {
+        QMutexLocker locker(&mutex);
+        return cache.maxCost();
+    }
+
+    void TileCache::setStore(TileStore* store) {
+        QMutexLocker locker(&mutex);
+        this->store = store;
+    }
+
+    bool TileCache::isEnabled() {
+        QMutexLocker locker(&mutex);
+        return cache.maxCost() > 0 || store;
+    }
+
+    bool TileCache::find(QString const& key, quint32* dst, int stride, int w, int h) {
+        TileStore* s;
+        {
+            QMutexLocker locker(&mutex);
+            QVector<quint32> const* tile = cache.object(key);
+            if(tile && tile->size() == w * h) {
+                for(int y = 0; y < h; y++) {
+                    memcpy(dst + y * stride, tile->constData() + y * w, w * sizeof(quint32));
+                }
+                return true;
+            }
+            s = store;
+        }
+        // 磁盘读取不占用内存缓存的锁, 命中后放回内存
+        if(!s || !s->find(key, dst, stride, w, h)) {
+            return false;
+        }
+        insert(key, dst, stride, w, h);
+        return true;
+    }
+
+    void TileCache::persist(QString const& key, const quint32* src, int stride, int w, int h) {
+        TileStore* s;
+        {
+            QMutexLocker locker(&mutex);
+            s = store;
+        }
+        if(s) {
+            s->insert(key, src, stride, w, h);
+        }
+    }
+
+    void TileCache::insert(QString const& key, const quint32* src, int stride, int w, int h) {
+        QVector<quint32>* tile = new QVector<quint32>(w * h);
+        for(int y = 0; y < h; y++) {
+            memcpy(tile->data() + y * w, src + y * stride, w * sizeof(quint32));
+        }
+        int cost = qMax(w * h * (int)sizeof(quint32) / 1024, 1);
+        QMutexLocker locker(&mutex);
+        if(cache.maxCost() <= 0) {
+            delete tile;
+            return;
+        }
+        // 超出容量时QCache自行删除tile
+        cache.insert(key, tile, cost);
+    }
+}
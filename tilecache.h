@@ -0,0 +1,97 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include "bigfixed.h"
+#include "floatexp.h"
+#include "tilestore.h"
+
+namespace Mandelbrot {
+
+    /**
+     * @brief 块缓存键: 决定迭代次数的设置(含迭代上限与两轴像素间距)、块左上角点的精确复坐标与块的大小.
+     * 与视图的大小和原点无关, 不同视图(预览与生成、平移整块后)中落在同一格点上的块共用缓存
+     */
+    class TileKeyer {
+    protected:
+        const QString prefix;
+    public:
+        explicit TileKeyer(QString const& prefix) : prefix(prefix) {}
+        virtual ~TileKeyer() {}
+        // 块左上角为图中像素(x0, y0), 大小w x h
+        virtual QString key(int x0, int y0, int w, int h) const = 0;
+    };
+
+    /**
+     * @brief float/double核心的键, 左上角坐标按读取器同样的式子以double算出
+     */
+    class PlaneTileKeyer : public TileKeyer {
+    private:
+        enum { PHASE = 1024 };
+        const double lux;
+        const double luy;
+        const double width;
+        const double height;
+        const int pwidth;
+        const int pheight;
+
+        static QString latticeText(double q);
+    public:
+        PlaneTileKeyer(QString const& prefix, double lux, double luy, double width, double height,
+                       int pwidth, int pheight);
+        virtual QString key(int x0, int y0, int w, int h) const;
+    };
+
+    /**
+     * @brief 高精度核心的键, 左上角坐标为中心点加上以FloatExp算出的偏移, 以定点数的十六进制文本写出
+     */
+    class BigTileKeyer : public TileKeyer {
+    private:
+        enum { PHASE_BITS = 10 };
+        const BigFixed center_real;
+        const BigFixed center_imag;
+        const FloatExp width;
+        const FloatExp height;
+        const int pwidth;
+        const int pheight;
+
+        // extent跨pixels个像素时键中保留的小数位数
+        static int keyBits(FloatExp const& extent, int pixels);
+    public:
+        BigTileKeyer(QString const& prefix, BigFixed const& center_real, BigFixed const& center_imag,
+                     FloatExp const& width, FloatExp const& height, int pwidth, int pheight);
+        virtual QString key(int x0, int y0, int w, int h) const;
+    };
+
+    /**
+     * @brief 块缓存: 以TileKeyer生成的键保存块的迭代次数
+     * 容量以KB计, 超出时淘汰最久未用的块. 预览与生成的计算线程并发读写, 内部加锁
+     * 设置磁盘块缓存后, 内存未命中时再查磁盘, 写入时同时写入磁盘
+     */
+    class TileCache {
+    private:
+        QMutex mutex;
+        QCache<QString, QVector<quint32> > cache;
+        TileStore* store;
+
+    public:
+        explicit TileCache(int capacity_kb);
+
+        void setCapacity(int capacity_kb);
+        int getCapacity();
+        // 为NULL时不使用磁盘块缓存
+        void setStore(TileStore* store);
+        bool isEnabled();
+        // 命中时将w x h的块写入行距为stride的dst, 返回true
+        bool find(QString const& key, quint32* dst, int stride, int w, int h);
+        // 只存入内存
+        void insert(QString const& key, const quint32* src, int stride, int w, int h);
+        // 写入磁盘块缓存, 未设置时忽略; 涉及文件写入, 不应在计算线程中调用
+        void persist(QString const& key, const quint32* src, int stride, int w, int h);
+    };
+}
+
+#endif // TILECACHE_H
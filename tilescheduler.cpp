@@ -0,0 +1,95 @@
+#include "tilescheduler.h"
+#include "mandelbrot.h"
+
+namespace Mandelbrot {
+
+    TileScheduler::TileScheduler(QVector<int> const& order, int worker_total) :
+        deques(), tile_total(order.size()), finished(0), done_mutex(), done() {
+        if(worker_total < 1) worker_total = 1;
+        for(int w = 0; w < worker_total; w++) {
+            Deque* d = new Deque;
+            d->head = 0;
+            d->tail = 0;
+            deques.append(d);
+        }
+        for(int i = 0; i < order.size(); i++) {
+            Deque* d = deques[i % worker_total];
+            d->tiles.append(order[i]);
+            d->tail++;
+        }
+        for(int w = 0; w < worker_total; w++) {
+            deques[w]->remaining = deques[w]->tail;
+        }
+    }
+
+    TileScheduler::~TileScheduler() {
+        for(int w = 0; w < deques.size(); w++) {
+            delete deques[w];
+        }
+    }
+
+    bool TileScheduler::popFront(Deque* d, int& tile) {
+        QMutexLocker locker(&d->mutex);
+        if(d->head >= d->tail) {
+            return false;
+        }
+        tile = d->tiles[d->head++];
+        d->remaining.fetchAndAddRelaxed(-1);
+        return true;
+    }
+
+    bool TileScheduler::popBack(Deque* d, int& tile) {
+        QMutexLocker locker(&d->mutex);
+        if(d->head >= d->tail) {
+            return false;
+        }
+        tile = d->tiles[--d->tail];
+        d->remaining.fetchAndAddRelaxed(-1);
+        return true;
+    }
+
+    bool TileScheduler::pop(int worker, int& tile) {
+        int n = deques.size();
+        worker %= n;
+        if(popFront(deques[worker], tile)) {
+            return true;
+        }
+        // 自己的队列已空, 从剩余最多的队列窃取, 直到全部为空
+        for(;;) {
+            int victim = -1;
+            int most = 0;
+            for(int i = 1; i < n; i++) {
+                int v = (worker + i) % n;
+                int r = atomicLoad(deques[v]->remaining);
+                if(r > most) {
+                    most = r;
+                    victim = v;
+                }
+            }
+            if(victim < 0) {
+                return false;
+            }
+            if(popBack(deques[victim], tile)) {
+                return true;
+            }
+        }
+    }
+
+    void TileScheduler::finish(int tile) {
+        {
+            QMutexLocker locker(&done_mutex);
+            done.append(tile);
+        }
+        finished.fetchAndAddRelaxed(1);
+    }
+
+    void TileScheduler::takeFinished(QVector<int>& tiles) {
+        QMutexLocker locker(&done_mutex);
+        tiles += done;
+        done.clear();
+    }
+
+    int TileScheduler::getProgress() {
+        return tile_total > 0 ? atomicLoad(finished) * 100 / tile_total : 100;
+    }
+}
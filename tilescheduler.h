@@ -0,0 +1,48 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+
+namespace Mandelbrot {
+
+    /**
+     * @brief 工作窃取式块调度器
+     * 每个计算线程一个双端队列, 线程从自己的队首取块, 自己的队列空时从其他线程的队尾窃取.
+     * 块按给定顺序(预估代价从高到低)轮流分配到各队列, 使昂贵的块最先开算, 减少收尾时的空闲.
+     */
+    class TileScheduler {
+    private:
+        struct Deque {
+            QMutex mutex;
+            QVector<int> tiles;
+            int head;
+            int tail;
+            QAtomicInt remaining; // 仅作窃取前的快速判空提示
+        };
+
+        QVector<Deque*> deques;
+        const int tile_total;
+        QAtomicInt finished;
+        QMutex done_mutex;
+        QVector<int> done; // 已完成但尚未取走的块
+
+        bool popFront(Deque* d, int& tile);
+        bool popBack(Deque* d, int& tile);
+
+    public:
+        TileScheduler(QVector<int> const& order, int worker_total);
+        ~TileScheduler();
+
+        // 取下一个块, 所有队列均空时返回false
+        bool pop(int worker, int& tile);
+        // 一个块计算完毕
+        void finish(int tile);
+        int getProgress();
+        // 取走自上次调用以来完成的块, 追加到tiles
+        void takeFinished(QVector<int>& tiles);
+    };
+}
+
+#endif // TILESCHEDULER_H
@@ -0,0 +1,211 @@
+#include "tilestore.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <cstring>
+
+namespace Mandelbrot {
+
+    /**
+     * @brief 块文件头, 其后为UTF-8的键(补齐到4字节)与按行存放的w x h个迭代次数
+     */
+    struct TileHeader {
+        quint32 magic;
+        quint32 version;
+        quint32 width;
+        quint32 height;
+        quint32 key_size;
+    };
+
+    static int alignedKeySize(int key_size) {
+        return (key_size + 3) & ~3;
+    }
+
+    TileStore::TileStore(QString const& dir, qint64 capacity) :
+        mutex(), dir(dir), capacity(capacity), total(0), clock(0), serial(0), writable(false), entries(), order() {
+        QDir d;
+        writable = d.mkpath(dir) && QFileInfo(dir).isWritable();
+        d.setPath(dir);
+        // 写到一半的临时文件直接删除
+        QFileInfoList tmp = d.entryInfoList(QStringList() << "*.tmp", QDir::Files);
+        for(int i = 0; i < tmp.size(); i++) {
+            QFile::remove(tmp[i].absoluteFilePath());
+        }
+        // 按修改时间从旧到新编号, 近似上次运行时的使用顺序
+        QFileInfoList files = d.entryInfoList(QStringList() << "*.tile", QDir::Files, QDir::Time | QDir::Reversed);
+        for(int i = 0; i < files.size(); i++) {
+            Entry e;
+            e.size = files[i].size();
+            e.used = ++clock;
+            entries.insert(files[i].fileName(), e);
+            order.insert(e.used, files[i].fileName());
+            total += e.size;
+        }
+    }
+
+    QString TileStore::fileName(QString const& key) const {
+        return QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex()) + ".tile";
+    }
+
+    void TileStore::touch(QString const& name) {
+        Entry& e = entries[name];
+        order.remove(e.used);
+        e.used = ++clock;
+        order.insert(e.used, name);
+    }
+
+    void TileStore::drop(QString const& name) {
+        Entry e = entries.value(name);
+        total -= e.size;
+        order.remove(e.used);
+        entries.remove(name);
+    }
+
+    void TileStore::evict(qint64 limit, QStringList& doomed) {
+        while(total > limit && !order.isEmpty()) {
+            QString name = order.begin().value();
+            drop(name);
+            doomed << name;
+        }
+    }
+
+    void TileStore::removeFiles(QStringList const& doomed) {
+        for(int i = 0; i < doomed.size(); i++) {
+            QFile::remove(dir + "/" + doomed[i]);
+        }
+    }
+
+    void TileStore::setCapacity(qint64 capacity) {
+        QStringList doomed;
+        {
+            QMutexLocker locker(&mutex);
+            this->capacity = capacity;
+            evict(capacity, doomed);
+        }
+        removeFiles(doomed);
+    }
+
+    qint64 TileStore::getCapacity() {
+        QMutexLocker locker(&mutex);
+        return capacity;
+    }
+
+    qint64 TileStore::getTotalSize() {
+        QMutexLocker locker(&mutex);
+        return total;
+    }
+
+    bool TileStore::find(QString const& key, quint32* dst, int stride, int w, int h) {
+        QString name = fileName(key);
+        {
+            QMutexLocker locker(&mutex);
+            if(!entries.contains(name)) {
+                return false;
+            }
+        }
+        // 读取期间文件可能被淘汰删除, 此时打开或映射失败, 按未命中处理
+        QFile file(dir + "/" + name);
+        const QByteArray k = key.toUtf8();
+        const qint64 data_offset = sizeof(TileHeader) + alignedKeySize(k.size());
+        bool opened = file.open(QIODevice::ReadOnly);
+        const qint64 size = opened ? file.size() : 0;
+        bool ok = false;
+        if(opened && size == data_offset + (qint64)(w * h * sizeof(quint32))) {
+            uchar* p = file.map(0, size);
+            if(p) {
+                TileHeader header;
+                memcpy(&header, p, sizeof(header));
+                ok = header.magic == MAGIC && header.version == VERSION
+                        && header.width == (quint32)w && header.height == (quint32)h
+                        && header.key_size == (quint32)k.size()
+                        && memcmp(p + sizeof(TileHeader), k.constData(), k.size()) == 0;
+                if(ok) {
+                    const uchar* data = p + data_offset;
+                    for(int y = 0; y < h; y++) {
+                        memcpy(dst + y * stride, data + y * w * sizeof(quint32), w * sizeof(quint32));
+                    }
+                }
+                file.unmap(p);
+            }
+        }
+        file.close();
+        QStringList doomed;
+        {
+            QMutexLocker locker(&mutex);
+            if(!entries.contains(name)) {
+                return ok;
+            }
+            if(ok) {
+                touch(name);
+            } else if(!opened || size < (qint64)sizeof(TileHeader)) {
+                // 散列冲突的文件留给原来的键, 丢失或损坏的文件从索引中去掉
+                drop(name);
+                doomed << name;
+            }
+        }
+        removeFiles(doomed);
+        return ok;
+    }
+
+    void TileStore::insert(QString const& key, const quint32* src, int stride, int w, int h) {
+        const QByteArray k = key.toUtf8();
+        const qint64 size = sizeof(TileHeader) + alignedKeySize(k.size()) + (qint64)w * h * sizeof(quint32);
+        QString name = fileName(key);
+        QString tmp;
+        QStringList doomed;
+        {
+            // 先在索引中占用空间, 写入失败时退还
+            QMutexLocker locker(&mutex);
+            if(size > capacity) {
+                return;
+            }
+            if(entries.contains(name)) {
+                // 旧文件随后被改名覆盖, 不删除
+                drop(name);
+            }
+            evict(capacity - size, doomed);
+            total += size;
+            tmp = dir + "/" + name + "." + QString::number(++serial) + ".tmp";
+        }
+        removeFiles(doomed);
+        // 先写临时文件再改名, 中途退出不会留下不完整的块文件
+        QString path = dir + "/" + name;
+        QFile file(tmp);
+        bool ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        if(ok) {
+            TileHeader header = {MAGIC, VERSION, (quint32)w, (quint32)h, (quint32)k.size()};
+            const char pad[4] = {0, 0, 0, 0};
+            ok = file.write((const char*)&header, sizeof(header)) == sizeof(header)
+                    && file.write(k.constData(), k.size()) == k.size()
+                    && file.write(pad, alignedKeySize(k.size()) - k.size()) == alignedKeySize(k.size()) - k.size();
+            for(int y = 0; ok && y < h; y++) {
+                const qint64 row = w * sizeof(quint32);
+                ok = file.write((const char*)(src + y * stride), row) == row;
+            }
+            file.close();
+            // QFile::rename不覆盖已有文件
+            if(ok && !file.rename(path)) {
+                QFile::remove(path);
+                ok = file.rename(path);
+            }
+        }
+        if(!ok) {
+            QFile::remove(tmp);
+        }
+        QMutexLocker locker(&mutex);
+        if(!ok) {
+            total -= size;
+            return;
+        }
+        if(entries.contains(name)) {
+            // 另一线程同时写入了同一块, 文件已被本次覆盖
+            drop(name);
+        }
+        Entry e;
+        e.size = size;
+        e.used = ++clock;
+        entries.insert(name, e);
+        order.insert(e.used, name);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef TILESTORE_H
+#define TILESTORE_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+namespace Mandelbrot {
+
+    /**
+     * @brief 磁盘块缓存, 程序重启后仍可取用
+     * 每块一个文件, 文件名为键的MD5, 文件头中另存完整的键以排除散列冲突; 读取时映射文件后直接复制.
+     * 总大小超出上限时删除最久未用的文件, 启动时扫描目录按修改时间恢复使用顺序.
+     * 内部加锁, 可被多线程并发调用; 锁只保护索引, 文件的读写与删除都在锁外进行
+     */
+    class TileStore {
+    private:
+        struct Entry {
+            qint64 size;
+            quint64 used; // 最近一次使用的序号
+        };
+
+        enum { MAGIC = 0x5456534d, VERSION = 1 }; // "MSVT"
+
+        QMutex mutex;
+        const QString dir;
+        qint64 capacity;
+        qint64 total;
+        quint64 clock;
+        quint64 serial; // 临时文件的序号, 并发写入同一块时互不干扰
+        bool writable;
+        QMap<QString, Entry> entries; // 文件名到大小与使用序号
+        QMap<quint64, QString> order; // 使用序号到文件名, 首项最久未用
+
+        QString fileName(QString const& key) const;
+        void touch(QString const& name);
+        // 只从索引中去掉, 不删除文件
+        void drop(QString const& name);
+        // 淘汰的文件名加入doomed, 由调用者在锁外删除
+        void evict(qint64 limit, QStringList& doomed);
+        void removeFiles(QStringList const& doomed);
+
+    public:
+        // 目录不存在时自动建立, capacity以字节计; 已有文件超出上限时待下次写入或setCapacity时才删除
+        TileStore(QString const& dir, qint64 capacity);
+
+        QString getDir() const { return dir; }
+        // 目录无法建立或不可写时为false, 此时不应使用
+        bool isWritable() const { return writable; }
+
+        void setCapacity(qint64 capacity);
+        qint64 getCapacity();
+        qint64 getTotalSize();
+        // 命中时将w x h的块写入行距为stride的dst, 返回true
+        bool find(QString const& key, quint32* dst, int stride, int w, int h);
+        void insert(QString const& key, const quint32* src, int stride, int w, int h);
+    };
+}
+
+#endif // TILESTORE_H
@@ -23,7 +23,7 @@ static void* timesrender_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
     return realloc(ptr, nsize);
 }
 
-TimesRender::TimesRender() : times_colors()
+TimesRender::TimesRender() : times_colors(), palette(NULL), palette_size(0)
 {
     // 设置 ud 所属类指针
     L = lua_newstate(timesrender_alloc, this);
@@ -53,9 +53,13 @@ QString TimesRender::load_render() {
 
     // 删除原函数
     lua_pushnil(L);
-    lua_setglobal(L, "times_shader");
+    lua_setglobal(L, "times_render");
+    lua_pushnil(L);
+    lua_setglobal(L, "times_render_batch");
 
     times_colors.clear();
+    palette = NULL;
+    palette_size = 0;
 
     int r;
 
@@ -70,6 +74,17 @@ QString TimesRender::load_render() {
         }
     }
 
+    // 优先使用批量着色函数, 未定义时才要求逐次着色函数
+    r = lua_getglobal(L, "times_render_batch");
+
+    if(r == LUA_TFUNCTION) {
+        QVector<QRgb> colors;
+        return call_batch(1, colors);
+    } else if(r != LUA_TNIL) {
+        return QString::fromUtf8("错误: 着色器\"times_render_batch\"应为函数");
+    }
+    lua_pop(L, 1);
+
     // 获取着色函数
     r = lua_getglobal(L, "times_render");
 
@@ -103,6 +118,56 @@ QString TimesRender::load_render() {
     return "";
 }
 
+/**
+ * @brief 调用批量着色函数times_render_batch(n), 取0..n-1次的颜色
+ * 返回值可为长度不少于3n的字符串(逐字节RGB), 或n个元素的表(每项为0xRRGGBB整数)
+ * 假定批量着色函数在栈顶, 调用后被弹出
+ */
+QString TimesRender::call_batch(size_t n, QVector<QRgb>& colors) {
+    lua_pushinteger(L, n);
+
+    // 假定错误处理函数在栈第1
+    int r = lua_pcall(L, 1, 1, 1);
+
+    if(r != LUA_OK) {
+        return QString::fromUtf8(r < err_descs_num ? err_descs[r] : "未知错误") + ": " + last_errstr;
+    }
+
+    colors.clear();
+    colors.reserve(n);
+
+    int t = lua_type(L, -1);
+    if(t == LUA_TSTRING) {
+        size_t len;
+        const unsigned char* p = (const unsigned char*)lua_tolstring(L, -1, &len);
+        if(len < 3 * n) {
+            lua_pop(L, 1);
+            return QString::fromUtf8("返回值错误: 字符串长度不足3n");
+        }
+        for(size_t i = 0; i < n; i++, p += 3) {
+            colors.append(qRgb(p[0], p[1], p[2]));
+        }
+    } else if(t == LUA_TTABLE) {
+        for(size_t i = 0; i < n; i++) {
+            int isnum;
+            lua_rawgeti(L, -1, i + 1);
+            lua_Integer c = lua_tointegerx(L, -1, &isnum);
+            lua_pop(L, 1);
+            if(!isnum) {
+                lua_pop(L, 1);
+                return QString::fromUtf8("返回值类型错误: 表中第%1项非整数").arg((int)i + 1);
+            }
+            colors.append(qRgb((c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff));
+        }
+    } else {
+        lua_pop(L, 1);
+        return QString::fromUtf8("返回值类型错误: 应为字符串或表");
+    }
+
+    lua_pop(L, 1);
+    return "";
+}
+
 QString TimesRender::read_render(const char* filename) {
     int r;
     r = luaL_loadfile(L, filename);
@@ -138,22 +203,37 @@ QString TimesRender::read_render() {
     return read_string(default_render);
 }
 
-QRgb TimesRender::getPixelColor(size_t times) {
+void TimesRender::prepare(size_t max_times) {
     QMutexLocker locker(&mutex_times_colors);
-    if(times >= (size_t)times_colors.size()) {
-        if(times < (size_t)times_colors.size()) {
-            return times_colors[times];
-        }
-        qDebug("debug: add!, %d", times_colors.size());
-        lua_settop(L, 1);
-        int t = lua_getglobal(L, "times_render");
-        if(t != LUA_TFUNCTION) {
-            qDebug("err: cannot find times_render or the type of times_render is not function");
-            return default_color;
+    if(max_times < (size_t)times_colors.size()) {
+        return;
+    }
+    lua_settop(L, 1);
+
+    // 批量着色函数一次调用取得整张色表
+    if(lua_getglobal(L, "times_render_batch") == LUA_TFUNCTION) {
+        QVector<QRgb> colors;
+        QString errstr = call_batch(max_times + 1, colors);
+        if(errstr.length() == 0) {
+            times_colors = colors;
+            palette = times_colors.constData();
+            palette_size = times_colors.size();
+            lua_settop(L, 1);
+            return;
         }
+        qDebug("err: times_render_batch failed, fallback to times_render");
+    }
+    lua_settop(L, 1);
 
+    int t = lua_getglobal(L, "times_render");
+    if(t != LUA_TFUNCTION) {
+        qDebug("err: cannot find times_render or the type of times_render is not function");
+        while((size_t)times_colors.size() <= max_times) {
+            times_colors.append(default_color);
+        }
+    } else {
         // 栈状态: 错误处理函数, 着色函数, 着色函数
-        for(size_t t = times_colors.size(); t <= times; t++) {
+        for(size_t t = times_colors.size(); t <= max_times; t++) {
             lua_settop(L, 3);
             lua_copy(L, -2, -1);
 
@@ -166,20 +246,34 @@ QRgb TimesRender::getPixelColor(size_t times) {
             }
 
             int rgb[3];
+            bool ok = true;
 
             for(int i = 0; i < 3; i++) {
                 int isnum;
                 rgb[i] = lua_tointegerx(L, i - 3, &isnum);
                 if(!isnum) {
-                    qDebug("err: return invaild");
-                    times_colors.append(default_color);
-                    continue;
+                    ok = false;
                 }
             }
 
+            if(!ok) {
+                qDebug("err: return invaild");
+                times_colors.append(default_color);
+                continue;
+            }
+
             times_colors.append(qRgb(rgb[0] & 0xff, rgb[1] & 0xff, rgb[2] & 0xff));
-            // qDebug("%d: %d %d %d", t, rgb[0], rgb[1], rgb[2]);
         }
     }
-    return times_colors[times];
+    lua_settop(L, 1);
+    palette = times_colors.constData();
+    palette_size = times_colors.size();
+}
+
+QRgb TimesRender::getPixelColor(size_t times) {
+    // 色表在prepare中一次建好, 计算期间只读, 无需加锁
+    if(times < palette_size) {
+        return palette[times];
+    }
+    return default_color;
 }
@@ -17,6 +17,9 @@ private:
     QVector<QRgb> times_colors;
     QString last_errstr;
     QMutex mutex_times_colors;
+    // times_colors的只读视图, 仅在prepare中更新
+    const QRgb* palette;
+    size_t palette_size;
 
 public:
 
@@ -31,10 +34,12 @@ public:
     QString read_render(const char *filename);
     QString read_string(QString const& luacode);
 
+    void prepare(size_t max_times);
     QRgb getPixelColor(size_t times);
 
 private:
     QString load_render();
+    QString call_batch(size_t n, QVector<QRgb>& colors);
 };
 
 #endif // TIMESRENDER_H
@@ -0,0 +1,210 @@
+#include "viewhistory.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QIcon>
+#include <QPixmap>
+#include <cstring>
+
+ViewHistory::ViewHistory(QString const& dir, qint64 capacity) :
+    dir(dir), capacity(capacity), total(0), clock(0), writable(false), entries(), order() {
+    QDir d;
+    writable = d.mkpath(dir) && QFileInfo(dir).isWritable();
+    d.setPath(dir);
+    // 上次异常退出时遗留的文件
+    QFileInfoList files = d.entryInfoList(QStringList() << "*.hist", QDir::Files);
+    for(int i = 0; i < files.size(); i++) {
+        QFile::remove(files[i].absoluteFilePath());
+    }
+}
+
+ViewHistory::~ViewHistory() {
+    clear();
+}
+
+QString ViewHistory::fileName(QString const& cfg) const {
+    return dir + "/" + QString(QCryptographicHash::hash(cfg.toUtf8(), QCryptographicHash::Md5).toHex()) + ".hist";
+}
+
+void ViewHistory::touch(Entry& e, QString const& cfg) {
+    order.remove(e.used);
+    e.used = ++clock;
+    order.insert(e.used, cfg);
+}
+
+/**
+ * @brief 把移到磁盘的记录读回内存, 失败时返回false
+ */
+bool ViewHistory::load(Entry& e, QString const& cfg) {
+    QFile file(fileName(cfg));
+    if(!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in >> e.data;
+    bool ok = in.status() == QDataStream::Ok && e.data.size() == e.size;
+    file.close();
+    file.remove();
+    e.spilled = false;
+    if(!ok) {
+        e.data = QByteArray();
+        e.size = 0;
+        return false;
+    }
+    total += e.size;
+    touch(e, cfg);
+    return true;
+}
+
+/**
+ * @brief 按最久未用的顺序把记录的迭代次数移到磁盘, 直到内存总量不超过limit; 缩略图始终留在内存.
+ * 写入失败的迭代次数直接丢弃, 只留缩略图
+ */
+void ViewHistory::evict(qint64 limit) {
+    while(total > limit && !order.isEmpty()) {
+        QString cfg = order.begin().value();
+        Entry& e = entries[cfg];
+        QFile file(fileName(cfg));
+        bool ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        if(ok) {
+            QDataStream out(&file);
+            out << e.data;
+            ok = out.status() == QDataStream::Ok;
+            file.close();
+        }
+        total -= e.size;
+        order.remove(e.used);
+        e.data = QByteArray();
+        if(ok) {
+            e.spilled = true;
+        } else {
+            file.remove();
+            e.size = 0;
+        }
+    }
+}
+
+void ViewHistory::clear() {
+    QMap<QString, Entry>::const_iterator it;
+    for(it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        if(it.value().spilled) {
+            QFile::remove(fileName(it.key()));
+        }
+    }
+    entries.clear();
+    order.clear();
+    total = 0;
+}
+
+void ViewHistory::setCapacity(qint64 capacity) {
+    this->capacity = capacity;
+    if(capacity <= 0) {
+        clear();
+    } else {
+        evict(capacity);
+    }
+}
+
+void ViewHistory::insert(QString const& cfg, QString const& view_key, Mandelbrot::TimesBuffer const& buf,
+                         bool keep_times, QImage const& image) {
+    if(capacity <= 0) {
+        return;
+    }
+    if(entries.contains(cfg)) {
+        Entry const& old = entries[cfg];
+        if(old.spilled) {
+            QFile::remove(fileName(cfg));
+        } else if(old.size > 0) {
+            total -= old.size;
+            order.remove(old.used);
+        }
+        total -= old.thumbnail.byteCount();
+        entries.remove(cfg);
+    }
+    Entry e;
+    e.view_key = view_key;
+    e.width = buf.width();
+    e.height = buf.height();
+    // 迭代次数大片相同, 压缩后通常只有原大小的几分之一
+    if(keep_times) {
+        e.data = qCompress(reinterpret_cast<const uchar*>(buf.constScanLine(0)),
+                           buf.width() * buf.height() * sizeof(quint32));
+    }
+    e.thumbnail = image.scaled(THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    e.size = e.data.size();
+    e.used = 0;
+    e.spilled = false;
+    const qint64 size = e.size + e.thumbnail.byteCount();
+    if(size > capacity) {
+        return;
+    }
+    evict(capacity - size);
+    entries.insert(cfg, e);
+    total += size;
+    if(e.size > 0) {
+        touch(entries[cfg], cfg);
+    }
+}
+
+Mandelbrot::TimesBuffer* ViewHistory::find(QString const& cfg, QString const& view_key, size_t max_times) {
+    if(!entries.contains(cfg)) {
+        return NULL;
+    }
+    Entry& e = entries[cfg];
+    if(e.view_key != view_key || (!e.spilled && e.size == 0)) {
+        return NULL;
+    }
+    bool spilled = e.spilled;
+    if(spilled) {
+        if(!load(e, cfg)) {
+            return NULL;
+        }
+    } else {
+        touch(e, cfg);
+    }
+    QByteArray raw = qUncompress(e.data);
+    const int width = e.width;
+    const int height = e.height;
+    if(spilled) {
+        // 读回后若超出上限, 移到磁盘的是其他更久未用的记录
+        evict(capacity);
+    }
+    if(raw.size() != (int)(width * height * sizeof(quint32))) {
+        return NULL;
+    }
+    Mandelbrot::TimesBuffer* buf = new Mandelbrot::TimesBuffer(width, height, max_times);
+    memcpy(buf->bits(), raw.constData(), raw.size());
+    return buf;
+}
+
+QImage ViewHistory::thumbnail(QString const& cfg) const {
+    QMap<QString, Entry>::const_iterator it = entries.find(cfg);
+    if(it == entries.constEnd()) {
+        return QImage();
+    }
+    return it.value().thumbnail;
+}
+
+HistoryModel::HistoryModel(QStringList const& strings, ViewHistory const& history, QObject* parent) :
+    QStringListModel(strings, parent), history(history) {
+}
+
+QVariant HistoryModel::data(QModelIndex const& index, int role) const {
+    if(role == Qt::DecorationRole && index.isValid()) {
+        QImage thumbnail = history.thumbnail(stringList().at(index.row()));
+        if(!thumbnail.isNull()) {
+            return QIcon(QPixmap::fromImage(thumbnail));
+        }
+        return QVariant();
+    }
+    return QStringListModel::data(index, role);
+}
+
+void HistoryModel::refresh(QString const& cfg) {
+    int row = stringList().indexOf(cfg);
+    if(row >= 0) {
+        emit dataChanged(index(row), index(row));
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef VIEWHISTORY_H
+#define VIEWHISTORY_H
+
+#include <QImage>
+#include <QMap>
+#include <QString>
+#include <QStringListModel>
+#include "mandelbrot.h"
+
+/**
+ * @brief 历史记录中各预览的迭代次数与缩略图, 按配置串检索
+ * 迭代次数压缩后存放, 内存总量(含缩略图)超出上限时把最久未用的记录的迭代次数移到磁盘, 再次取用时读回;
+ * 缩略图每张只有十余KB, 始终留在内存, 列表图标不会消失. 仅在界面线程中使用
+ */
+class ViewHistory {
+private:
+    struct Entry {
+        QString view_key; // 配置串以外的计算设置, 不同时视为未命中
+        int width;
+        int height;
+        QByteArray data; // qCompress后的迭代次数
+        QImage thumbnail;
+        qint64 size; // data的字节数, 为0时迭代次数已丢失, 只剩缩略图
+        quint64 used;
+        bool spilled; // data已移到磁盘
+    };
+
+    const QString dir;
+    qint64 capacity;
+    qint64 total; // 内存中的data与全部缩略图
+    quint64 clock;
+    bool writable;
+    QMap<QString, Entry> entries;
+    QMap<quint64, QString> order; // data在内存中的记录, 首项最久未用
+
+    QString fileName(QString const& cfg) const;
+    void touch(Entry& e, QString const& cfg);
+    bool load(Entry& e, QString const& cfg);
+    void evict(qint64 limit);
+    void clear();
+
+public:
+    enum { THUMBNAIL_WIDTH = 64, THUMBNAIL_HEIGHT = 48 };
+
+    // 移到磁盘的记录存于dir, 退出时删除; capacity以字节计, 为0时不保存
+    ViewHistory(QString const& dir, qint64 capacity);
+    ~ViewHistory();
+
+    QString getDir() const { return dir; }
+    // 目录无法建立或不可写时为false, 超出上限的记录只保留缩略图
+    bool isWritable() const { return writable; }
+
+    void setCapacity(qint64 capacity);
+    // image为着色后的预览, 缩小后作为缩略图; keep_times为false时只保存缩略图
+    void insert(QString const& cfg, QString const& view_key, Mandelbrot::TimesBuffer const& buf, bool keep_times,
+                QImage const& image);
+    // 命中时返回迭代次数的副本, 由调用者释放; 否则返回NULL
+    Mandelbrot::TimesBuffer* find(QString const& cfg, QString const& view_key, size_t max_times);
+    // 没有时返回空图
+    QImage thumbnail(QString const& cfg) const;
+};
+
+/**
+ * @brief 历史记录列表, 各项以预览缩略图为图标
+ */
+class HistoryModel : public QStringListModel {
+private:
+    ViewHistory const& history;
+
+public:
+    HistoryModel(QStringList const& strings, ViewHistory const& history, QObject* parent = 0);
+
+    QVariant data(QModelIndex const& index, int role) const;
+    // 记录的缩略图更新后重绘该行
+    void refresh(QString const& cfg);
+};
+
+#endif // VIEWHISTORY_H